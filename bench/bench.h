@@ -0,0 +1,29 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Runs `body` `runs` times and returns the fastest wall time in seconds; on a busy machine the minimum is the least noisy figure.
+// `setup` runs before each timed run and is not counted.
+template <typename Setup, typename Body>
+double fastest(int runs, Setup&& setup, Body&& body){
+  double best = 1e300;
+  for(int run = 0; run < runs; run++){
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    best = std::min(best, std::chrono::duration <double> (std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+template <typename Body>
+double fastest(int runs, Body&& body){
+  return fastest(runs, []{}, body);
+}
+
+// Keeps the compiler from dropping a computation whose result is otherwise unused.
+template <typename T>
+void keep(const T& value){
+  asm volatile("" : : "g"(&value) : "memory");
+}
@@ -0,0 +1,70 @@
+// Copy-on-write payloads: what copying a string or array Value costs when the payload is shared, against the deep copy
+// every copy made before, and the two script workloads that motivated the change.
+#include <sstream>
+#include <string>
+#include "AST.h"
+#include "bench.h"
+#include "doublec.h"
+
+static constexpr int runs = 5;
+
+static double script(const std::string& source){
+  auto program = doublec::compile(source);
+  return fastest(runs, [&]{
+    std::istringstream in;
+    std::ostringstream out;
+    doublec::Context(in, out).run(*program);
+  });
+}
+
+int main(){
+  static constexpr int copies = 20000;
+  Value text{Datatype::String, String(200000, 'x')};
+  Value numbers{Datatype::Array, Array{Datatype::Int, Buffer <int64_t> (1000000, 1)}};
+  std::printf("%d copies, fastest of %d runs in seconds:\n", copies, runs);
+  auto sharedText = fastest(runs, [&]{
+    for(int i = 0; i < copies; i++){
+      Value copy = text;
+      keep(copy);
+    }
+  });
+  auto deepText = fastest(runs, [&]{
+    for(int i = 0; i < copies; i++){
+      Value copy{Datatype::String, String(*std::get <Cow <String>> (text.data))};
+      keep(copy);
+    }
+  });
+  std::printf("  200 KB string   shared %8.4f  deep %8.4f\n", sharedText, deepText);
+  auto sharedArray = fastest(runs, [&]{
+    for(int i = 0; i < copies / 100; i++){
+      Value copy = numbers;
+      keep(copy);
+    }
+  });
+  auto deepArray = fastest(runs, [&]{
+    for(int i = 0; i < copies / 100; i++){
+      Value copy{Datatype::Array, Array(*std::get <Cow <Array>> (numbers.data))};
+      keep(copy);
+    }
+  });
+  std::printf("  1M int array    shared %8.4f  deep %8.4f  (%d copies)\n", sharedArray, deepArray, copies / 100);
+  std::printf("scripts, fastest of %d runs in seconds:\n", runs);
+  std::printf("  compare two 200 KB strings 20000 times  %8.3f\n", script(
+    "s = \"\"\n"
+    "for(i -> 200000){\n"
+    "  s = s + \"x\"\n"
+    "}\n"
+    "t = s\n"
+    "n = 0\n"
+    "for(i -> 20000){\n"
+    "  if(s == t){\n"
+    "    n = n + 1\n"
+    "  }\n"
+    "  k = len(s)\n"
+    "}\n"));
+  std::printf("  b = a * 2 on 1M elements, 200 times     %8.3f\n", script(
+    "a = array(1000000, 1)\n"
+    "for(i -> 200){\n"
+    "  b = a * 2\n"
+    "}\n"));
+}
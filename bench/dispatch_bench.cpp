@@ -0,0 +1,48 @@
+// Binary operators through the operator/type dispatch table: one script per operator applies it 400k times to each
+// operand type pair it accepts. The baseline script does the same assignments with a plain variable read, so the
+// difference is what evaluating the operator costs.
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "doublec.h"
+
+static constexpr int runs = 5;
+static constexpr int iterations = 400000;
+
+static double script(const std::vector <std::string>& lines){
+  std::string source = "a = 7\nb = 3\nd = 2.5\nc = 'c'\ns = \"ab\"\nt = \"ac\"\nfor(i -> " + std::to_string(iterations) + "){\n";
+  for(const auto& line : lines) source += "  r = " + line + "\n";
+  source += "}\n";
+  auto program = doublec::compile(source);
+  return fastest(runs, [&]{
+    std::istringstream in;
+    std::ostringstream out;
+    doublec::Context(in, out).run(*program);
+  });
+}
+
+int main(){
+  std::printf("%d iterations, fastest of %d runs; ns per operation above a plain read:\n", iterations, runs);
+  std::printf("  %-3s %-48s %9s %8s\n", "op", "operand types", "seconds", "ns/op");
+  for(auto op : {"+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!="}){
+    std::string symbol(op);
+    std::vector <std::string> lines;
+    std::string types;
+    if(symbol == "%"){
+      lines = {"a % b"};
+      types = "int/int";
+    }
+    else{
+      lines = {"a " + symbol + " b", "a " + symbol + " d", "c " + symbol + " a", "d " + symbol + " a"};
+      types = "int/int int/double char/int double/int";
+      if(symbol != "-" && symbol != "*" && symbol != "/"){
+        lines.push_back("s " + symbol + " t");
+        types += " string/string";
+      }
+    }
+    auto seconds = script(lines);
+    auto baseline = script(std::vector <std::string> (lines.size(), "a"));
+    std::printf("  %-3s %-48s %9.3f %8.1f\n", op, types.c_str(), seconds, (seconds - baseline) * 1e9 / (double(iterations) * lines.size()));
+  }
+}
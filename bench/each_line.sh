@@ -0,0 +1,47 @@
+#!/bin/bash
+# Throughput of --each-line against starting one process per record, on generated records of 20 to 60 characters
+# with a script that prints the lines longer than 40 characters.
+# Usage: bench/each_line.sh DOUBLEC [RECORDS] [PROCESS_RECORDS]
+# DOUBLEC is the interpreter to measure, e.g. build/DoubleCOptimized from a -DDOUBLEC_BENCHMARKS=ON build.
+set -euo pipefail
+doublec=$(realpath "$1")
+records=${2:-1000000}
+processRecords=${3:-200}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+cat > "$work/each.dc" <<'SCRIPT'
+if(len(line) > 40){
+  out(line)
+  out("\n")
+}
+SCRIPT
+cat > "$work/single.dc" <<'SCRIPT'
+line = readline()
+if(len(line) > 40){
+  out(line)
+  out("\n")
+}
+SCRIPT
+awk -v n="$records" 'BEGIN{ srand(1); for(i = 0; i < n; i++){ s = sprintf("%d:", i); while(length(s) < 20 + int(rand() * 41)) s = s "x"; print s } }' > "$work/records.txt"
+head -n "$processRecords" "$work/records.txt" > "$work/sample.txt"
+bytes=$(stat -c %s "$work/records.txt")
+
+# Wall time of a command in nanoseconds.
+elapsed(){
+  local start end
+  start=$(date +%s%N)
+  "$@"
+  end=$(date +%s%N)
+  echo $((end - start))
+}
+
+"$doublec" --each-line "$work/each.dc" < "$work/sample.txt" > /dev/null
+each=$(elapsed sh -c '"$0" --each-line "$1" < "$2" > /dev/null' "$doublec" "$work/each.dc" "$work/records.txt")
+single=$(elapsed sh -c 'while IFS= read -r record; do printf "%s\n" "$record" | "$0" "$1" > /dev/null; done < "$2"' "$doublec" "$work/single.dc" "$work/sample.txt")
+
+awk -v records="$records" -v bytes="$bytes" -v each="$each" -v single="$single" -v sample="$processRecords" 'BEGIN{
+  printf "%d records, %d bytes\n", records, bytes
+  printf "  --each-line:         %8.3f s, %6.2f us per record, %6.1f MB/s\n", each / 1e9, each / 1e3 / records, bytes * 1e3 / each
+  printf "  process per record:  %8.3f s for %d records, %.2f ms each, %.0f s extrapolated\n", single / 1e9, sample, single / 1e6 / sample, single / 1e9 * records / sample
+}'
@@ -0,0 +1,45 @@
+// The whole-array kernels on each path this CPU supports, scalar first, over 1M-element arrays.
+#include <numeric>
+#include <vector>
+#include "bench.h"
+#include "kernels.h"
+
+static constexpr size_t size = 1000000;
+static constexpr int repeats = 50;
+static constexpr int runs = 5;
+
+int main(){
+  std::vector <double> a(size), b(size), doubles(size);
+  std::vector <int64_t> x(size), y(size), ints(size);
+  std::vector <char> flags(size);
+  for(size_t i = 0; i < size; i++){
+    a[i] = i * 0.5;
+    b[i] = 1.0 + i % 7;
+    x[i] = static_cast <int64_t> (i);
+    y[i] = static_cast <int64_t> (i % 13);
+  }
+  std::printf("%zu elements, %d calls per figure, fastest of %d runs in milliseconds:\n", size, repeats, runs);
+  std::printf("  %-7s %9s %9s %9s %9s %9s %9s %9s %9s\n", "path", "d a*b", "d a+2", "d a<b", "i x+y", "i x<y", "d sum", "i max", "count");
+  for(auto path : {"scalar", "sse2", "avx2"}){
+    if(!kernels::select(path)) continue;
+    auto time = [&](auto&& body){
+      return fastest(runs, [&]{
+        for(int i = 0; i < repeats; i++) body();
+      }) * 1000;
+    };
+    double two = 2.0;
+    double results[] = {
+      time([&]{ kernels::arithmetic(Operator::Mul, a.data(), false, b.data(), false, doubles.data(), size); }),
+      time([&]{ kernels::arithmetic(Operator::Add, a.data(), false, &two, true, doubles.data(), size); }),
+      time([&]{ kernels::compare(Operator::Less, a.data(), false, b.data(), false, flags.data(), size); }),
+      time([&]{ kernels::arithmetic(Operator::Add, x.data(), false, y.data(), false, ints.data(), size); }),
+      time([&]{ kernels::compare(Operator::Less, x.data(), false, y.data(), false, flags.data(), size); }),
+      time([&]{ keep(kernels::sum(a.data(), size)); }),
+      time([&]{ keep(kernels::max(x.data(), size)); }),
+      time([&]{ keep(kernels::count(flags.data(), size)); }),
+    };
+    std::printf("  %-7s", path);
+    for(auto result : results) std::printf(" %9.2f", result);
+    std::printf("\n");
+  }
+}
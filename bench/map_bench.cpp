@@ -0,0 +1,106 @@
+// Map against std::unordered_map on million-key workloads: inserts, shuffled lookups and erasing half the keys,
+// with int and string keys. unordered_map<Value, Value> uses the same hash and key equality as Map;
+// unordered_map<int64_t, int64_t> shows what a table of raw integers costs.
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "bench.h"
+#include "map.h"
+
+static constexpr size_t keyCount = 1000000;
+static constexpr int runs = 5;
+
+static uint64_t mix(uint64_t x){
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  return x ^ (x >> 33);
+}
+
+struct ValueHash{
+  size_t operator()(const Value& key) const{
+    if(key.type != Datatype::String) return mix(static_cast <uint64_t> (std::get <int64_t> (key.data)));
+    auto& str = *std::get <Cow <String>> (key.data);
+    return mix(std::hash <std::string_view> ()(std::string_view(str.data(), str.size())));
+  }
+};
+
+struct ValueEqual{
+  bool operator()(const Value& left, const Value& right) const{
+    if(left.type != right.type) return false;
+    if(left.type != Datatype::String) return std::get <int64_t> (left.data) == std::get <int64_t> (right.data);
+    return *std::get <Cow <String>> (left.data) == *std::get <Cow <String>> (right.data);
+  }
+};
+
+using ValueTable = std::unordered_map <Value, Value, ValueHash, ValueEqual>;
+
+static std::vector <Value> makeKeys(bool strings){
+  std::vector <Value> keys;
+  keys.reserve(keyCount);
+  std::mt19937_64 random(42);
+  for(size_t i = 0; i < keyCount; i++){
+    auto number = static_cast <int64_t> (random() >> 1);
+    if(strings){
+      auto text = "key-" + std::to_string(number);
+      keys.push_back({Datatype::String, String(text.begin(), text.end())});
+    }
+    else keys.push_back({Datatype::Int, number});
+  }
+  return keys;
+}
+
+static std::vector <size_t> shuffled(size_t count){
+  std::vector <size_t> order(count);
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(7));
+  return order;
+}
+
+template <typename Table, typename Insert, typename Find, typename Erase>
+static void measure(const char* name, const std::vector <Value>& keys, Insert insert, Find find, Erase erase){
+  auto order = shuffled(keys.size());
+  Table table;
+  auto inserting = fastest(runs, [&]{ table = Table(); }, [&]{
+    for(size_t i = 0; i < keys.size(); i++) insert(table, keys[i], i);
+  });
+  auto looking = fastest(runs, [&]{
+    int64_t total = 0;
+    for(auto index : order) total += find(table, keys[index]);
+    keep(total);
+  });
+  auto erasing = fastest(runs, [&]{
+    table = Table();
+    for(size_t i = 0; i < keys.size(); i++) insert(table, keys[i], i);
+  }, [&]{
+    for(size_t i = 0; i < keys.size() / 2; i++) erase(table, keys[order[i]]);
+  });
+  std::printf("  %-34s insert %6.3f  lookup %6.3f  erase half %6.3f\n", name, inserting, looking, erasing);
+}
+
+static void compare(bool strings){
+  auto keys = makeKeys(strings);
+  std::printf("%s keys, %zu of them, fastest of %d runs in seconds:\n", strings ? "string" : "int", keys.size(), runs);
+  measure <Map> ("Map", keys,
+    [](Map& table, const Value& key, size_t i){ table.insert(key) = {Datatype::Int, static_cast <int64_t> (i)}; },
+    [](const Map& table, const Value& key){ return std::get <int64_t> (table.find(key)->data); },
+    [](Map& table, const Value& key){ table.erase(key); });
+  measure <ValueTable> ("unordered_map<Value, Value>", keys,
+    [](ValueTable& table, const Value& key, size_t i){ table[key] = {Datatype::Int, static_cast <int64_t> (i)}; },
+    [](const ValueTable& table, const Value& key){ return std::get <int64_t> (table.find(key)->second.data); },
+    [](ValueTable& table, const Value& key){ table.erase(key); });
+  if(strings) return;
+  using IntTable = std::unordered_map <int64_t, int64_t>;
+  measure <IntTable> ("unordered_map<int64_t, int64_t>", keys,
+    [](IntTable& table, const Value& key, size_t i){ table[std::get <int64_t> (key.data)] = i; },
+    [](const IntTable& table, const Value& key){ return table.find(std::get <int64_t> (key.data))->second; },
+    [](IntTable& table, const Value& key){ table.erase(std::get <int64_t> (key.data)); });
+}
+
+int main(){
+  compare(false);
+  compare(true);
+}
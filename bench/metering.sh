@@ -0,0 +1,60 @@
+#!/bin/bash
+# What step metering costs: each script runs on an interpreter built without metering, on the regular one with no
+# limits, and on the regular one with both limits set far above what the script needs. Fastest of RUNS runs.
+# Usage: bench/metering.sh METERED UNMETERED [RUNS]
+# METERED and UNMETERED are DoubleCOptimized and DoubleCUnmetered from a -DDOUBLEC_BENCHMARKS=ON build.
+set -euo pipefail
+metered=$(realpath "$1")
+unmetered=$(realpath "$2")
+runs=${3:-9}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+cat > "$work/while.dc" <<'SCRIPT'
+i = 0
+while(i < 3000000){
+  i = i + 1
+}
+out(i)
+SCRIPT
+cat > "$work/for_if.dc" <<'SCRIPT'
+n = 0
+for(i -> 3000000){
+  if(i % 3 == 0){
+    n = n + 1
+  }
+}
+out(n)
+SCRIPT
+cat > "$work/calls.dc" <<'SCRIPT'
+func fib(n){
+  if(n < 2){
+    return n
+  }
+  return fib(n - 1) + fib(n - 2)
+}
+out(fib(25))
+SCRIPT
+
+# Fastest wall time of a command over $runs runs, in nanoseconds.
+fastest(){
+  local best=0 start end
+  for((run = 0; run < runs; run++)); do
+    start=$(date +%s%N)
+    "$@" > /dev/null
+    end=$(date +%s%N)
+    if((best == 0 || end - start < best)); then best=$((end - start)); fi
+  done
+  echo $best
+}
+
+printf "fastest of %d runs in seconds:\n" "$runs"
+printf "  %-10s %10s %10s %14s\n" script unmetered "no limits" "both limits"
+for script in while for_if calls; do
+  base=$(fastest "$unmetered" --no-cache "$work/$script.dc")
+  plain=$(fastest "$metered" --no-cache "$work/$script.dc")
+  limited=$(fastest "$metered" --no-cache --max-steps 1000000000000 --timeout 3600 "$work/$script.dc")
+  awk -v name="$script" -v base="$base" -v plain="$plain" -v limited="$limited" 'BEGIN{
+    printf "  %-10s %10.3f %10.3f %14.3f   (%+.1f%%, %+.1f%%)\n", name, base / 1e9, plain / 1e9, limited / 1e9, (plain / base - 1) * 100, (limited / base - 1) * 100
+  }'
+done
@@ -2,9 +2,12 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <variant>
 #include <cstdint>
+#include "accounting.h"
 
 enum class Datatype{
     Int,
@@ -13,6 +16,7 @@ enum class Datatype{
     Double,
     Bool,
     Array,
+    Map,
     Invalid
 };
 
@@ -34,9 +38,42 @@ enum class Operator{
   Invalid
 };
 
+struct Value;
+class Map;
+class BigInt;
+
+template <typename T>
+class Cow {
+  public:
+  Cow() : payload(std::allocate_shared <T> (CountingAllocator <T, MemoryCategory::Values> ())) {}
+  Cow(T value) : payload(std::allocate_shared <T> (CountingAllocator <T, MemoryCategory::Values> (), std::move(value))) {}
+  const T& operator*() const { return *payload; }
+  const T* operator->() const { return payload.get(); }
+  bool unique() const { return payload.use_count() == 1; }
+  T& mutate(){
+    if(!unique()) payload = std::allocate_shared <T> (CountingAllocator <T, MemoryCategory::Values> (), *payload);
+    return *payload;
+  }
+  private:
+  std::shared_ptr <T> payload;
+};
+
+template <typename T>
+using Buffer = std::vector <T, CountingAllocator<T, MemoryCategory::Values>>;
+using ValueArray = Buffer <Value>;
+
+struct Array {
+  Datatype type = Datatype::Invalid;
+  std::variant <Buffer <int64_t>, Buffer <double>, Buffer <char>, ValueArray> items = ValueArray();
+  size_t size() const { return std::visit([](const auto& buffer){ return buffer.size(); }, items); }
+  bool boxed() const { return type == Datatype::Invalid; }
+};
+
+using ValueData = std::variant <int64_t, char, Cow <String>, double, bool, Cow <Array>, Cow <Map>, Cow <BigInt>>;
+
 struct Value {
   Datatype type;
-  std::variant <int64_t, char, std::string, double, bool, std::vector <Value> > data; 
+  ValueData data; 
 };
 
 struct Location{
@@ -47,6 +84,8 @@ struct Location{
 struct AST{
     Location location;
     virtual ~AST() = default;
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
 };
 
 struct Statement : AST {};
@@ -56,6 +95,19 @@ struct Program : AST {
     std::vector <std::unique_ptr<Statement>> statements;
 };
 
+// A block the parser has only brace-matched; its statements are parsed the first time it runs, once even across threads.
+struct LazyProgram : Program {
+    std::function <void(Program&)> parse;
+    mutable std::once_flag loaded;
+    void load() const {
+      std::call_once(loaded, [&](){
+        auto& self = const_cast <LazyProgram&> (*this);
+        self.parse(self);
+        self.parse = nullptr;
+      });
+    }
+};
+
 struct Declaration : Statement {
      Datatype type;
      std::string name;
@@ -71,6 +123,14 @@ struct Output : Statement {
 
 struct Definition : Statement {
     std::string name;
+    int slot = -1;
+    std::unique_ptr <Expression> value;
+};
+
+struct ElementDefinition : Statement {
+    std::string name;
+    int slot = -1;
+    std::vector <std::unique_ptr <Expression>> index;
     std::unique_ptr <Expression> value;
 };
 
@@ -87,18 +147,75 @@ struct While : Statement {
 
 struct For : Statement {
   Operator op;
+  bool parallel = false;
   std::unique_ptr <Definition> step = nullptr;
   std::unique_ptr <Definition> Initialvalue = std::make_unique<Definition> ();
   std::unique_ptr <Expression> Finalvalue;
   std::unique_ptr <Program> Instructions;
 };
 
+// An else-if chain comparing one variable to distinct int or char literals, indexed by the literal.
+// The original chain is kept and runs when the variable is not an int, char or bool.
+struct Switch : Statement {
+  std::string name;
+  int slot = -1;
+  std::unique_ptr <IfStatement> chain;
+  const Program* otherwise = nullptr;
+  int64_t base = 0;
+  std::vector <const Program*> dense;
+  std::vector <std::pair <int64_t, const Program*>> slots;
+  uint64_t multiplier = 0;
+  int shift = 0;
+  const Program* find(int64_t key) const {
+    if(!dense.empty()){
+      auto index = static_cast <uint64_t> (key) - static_cast <uint64_t> (base);
+      if(index < dense.size() && dense[index]) return dense[index];
+      return otherwise;
+    }
+    auto& slot = slots[(static_cast <uint64_t> (key) * multiplier) >> shift];
+    return slot.second && slot.first == key ? slot.second : otherwise;
+  }
+};
+
 struct exprValue : Expression {
   Value value;
 };
 
+// Inside a function body `slot` indexes the locals of the call; elsewhere it is -1 and the name is looked up in the scopes.
 struct Variable : Expression {
     std::string name;
+    int slot = -1;
+};
+
+// `x = x op literal` with an int or double literal, applied to x in place.
+// The original definition runs whenever the in-place update would not give the same result.
+struct Update : Statement {
+  std::string name;
+  int slot = -1;
+  Operator op;
+  Value operand;
+  std::unique_ptr <Definition> original;
+};
+
+// A while condition comparing a variable with a literal or another variable; ints and doubles are compared
+// where they are stored, anything else evaluates the original expression.
+struct Comparison : Expression {
+  Operator op;
+  std::string name;
+  int slot = -1;
+  std::unique_ptr <Variable> other;
+  Value literal;
+  std::unique_ptr <Expression> original;
+};
+
+// out() of a literal, rendered once by the optimizer.
+struct OutputText : Statement {
+  std::string text;
+};
+
+// Drops variables of the enclosing block once no later statement of the block uses them.
+struct Release : Statement {
+  std::vector <std::string> names;
 };
 
 struct Binary : Expression {
@@ -111,3 +228,40 @@ struct Cast : Expression {
   Datatype castTo;
   std::unique_ptr <Expression> expr;
 };
+
+struct ArrayLiteral : Expression {
+  std::vector <std::unique_ptr <Expression>> elements;
+};
+
+struct MapLiteral : Expression {
+  std::vector <std::unique_ptr <Expression>> keys;
+  std::vector <std::unique_ptr <Expression>> values;
+};
+
+struct Index : Expression {
+  std::unique_ptr <Expression> base;
+  std::unique_ptr <Expression> index;
+};
+
+struct Call : Expression {
+  std::string name;
+  std::vector <std::unique_ptr <Expression>> arguments;
+};
+
+struct CallStatement : Statement {
+  std::unique_ptr <Call> call;
+};
+
+// A top-level function. Its body only sees its own locals: every name used in it gets a slot, parameters first.
+// Calls to a pure function are cached by their arguments.
+struct Function : Statement {
+  std::string name;
+  bool pure = false;
+  std::vector <std::string> parameters;
+  size_t slots = 0;
+  std::unique_ptr <Program> body;
+};
+
+struct Return : Statement {
+  std::unique_ptr <Expression> value;
+};
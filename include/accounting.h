@@ -0,0 +1,64 @@
+#pragma once
+#include <iostream>
+#include <array>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+enum class MemoryCategory : uint8_t {
+  Values,
+  Scopes,
+  AST,
+  amount
+};
+
+class memory_limit_error : public std::runtime_error{
+  public:
+  memory_limit_error(const std::string& msg);
+};
+
+class MemoryTracker{
+  public:
+  size_t limit = 0;
+  void allocate(MemoryCategory category, size_t bytes);
+  void release(MemoryCategory category, size_t bytes);
+  int64_t current(MemoryCategory category) const;
+  int64_t peak(MemoryCategory category) const;
+  int64_t total() const;
+  int64_t totalPeak() const;
+  void report(std::ostream& out) const;
+  // The tracker charged by CountingAllocator and AST nodes on this thread (nullptr = untracked)
+  static MemoryTracker*& active();
+  private:
+  std::array <std::atomic <int64_t>, static_cast <size_t> (MemoryCategory::amount)> currentBytes{};
+  std::array <std::atomic <int64_t>, static_cast <size_t> (MemoryCategory::amount)> peakBytes{};
+  std::atomic <int64_t> totalBytes{0};
+  std::atomic <int64_t> totalPeakBytes{0};
+};
+
+template <typename T, MemoryCategory category>
+struct CountingAllocator{
+  using value_type = T;
+  template <typename U> struct rebind { using other = CountingAllocator<U, category>; };
+
+  CountingAllocator() noexcept = default;
+  template <typename U> CountingAllocator(const CountingAllocator<U, category>&) noexcept {}
+
+  T* allocate(size_t n){
+    if(auto tracker = MemoryTracker::active()) tracker->allocate(category, n * sizeof(T));
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* ptr, size_t n) noexcept{
+    if(auto tracker = MemoryTracker::active()) tracker->release(category, n * sizeof(T));
+    std::allocator<T>().deallocate(ptr, n);
+  }
+  template <typename U> bool operator==(const CountingAllocator<U, category>&) const noexcept { return true; }
+  template <typename U> bool operator!=(const CountingAllocator<U, category>&) const noexcept { return false; }
+};
+
+using String = std::basic_string <char, std::char_traits<char>, CountingAllocator<char, MemoryCategory::Values>>;
+
+size_t parseMemorySize(const std::string& text);
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "doublec.h"
+
+namespace doublec{
+  // One manifest line: script, input file and output file, separated by whitespace. "-" reads no input or keeps the output in memory.
+  struct BatchJob{
+    std::string script;
+    std::string input;
+    std::string output;
+  };
+
+  struct BatchResult{
+    int code = 0;
+    std::string error;
+    std::string output;
+  };
+
+  std::vector <BatchJob> readManifest(const std::string& path);
+  // Each script is compiled once and shared by its jobs. The jobs run as scheduler tasks preempted every `slice` statements,
+  // each with its own interpreter, input and output buffers, memory tracker and limits.
+  std::vector <BatchResult> runBatch(const std::vector <BatchJob>& jobs, const ProgramCache* cache, size_t memoryLimit, TraceBuffer* trace, size_t slice = 10000, const Limits& limits = {});
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "AST.h"
+
+// Sign and magnitude integer with 32-bit limbs, least significant first; zero has no limbs and is never negative.
+// Ints that fit in int64_t stay inline in Value, so a BigInt only ever holds values outside that range.
+class BigInt {
+  public:
+  BigInt() = default;
+  BigInt(int64_t value);
+  // Parses an optional '-' followed by decimal digits; throws std::invalid_argument on anything else.
+  static BigInt parse(std::string_view text);
+  bool fits() const;
+  int64_t toInt64() const;
+  double toDouble() const;
+  std::string toString() const;
+  bool negative() const { return sign; }
+  size_t hash() const;
+  friend BigInt operator+(const BigInt& left, const BigInt& right);
+  friend BigInt operator-(const BigInt& left, const BigInt& right);
+  friend BigInt operator*(const BigInt& left, const BigInt& right);
+  // Truncates toward zero like the built-in integers, so the remainder has the sign of the dividend.
+  friend BigInt operator%(const BigInt& left, const BigInt& right);
+  friend int compare(const BigInt& left, const BigInt& right);
+  friend bool operator==(const BigInt& left, const BigInt& right){ return compare(left, right) == 0; }
+  private:
+  bool sign = false;
+  Buffer <uint32_t> limbs;
+  void trim();
+};
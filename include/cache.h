@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "AST.h"
+
+// Parsed programs stored as <directory>/<key>.dcc, where the key hashes the source text and the interpreter version.
+// Files that fail the header or checksum test are ignored and rewritten after parsing.
+class ProgramCache{
+  public:
+  // Bumped whenever the serialized layout or what the parser accepts changes; a different format never matches a stored file.
+  static constexpr uint32_t currentFormat = 5;
+  explicit ProgramCache(std::string directory, uint32_t format = currentFormat);
+  bool load(const std::string& source, Program& program) const;
+  void store(const std::string& source, const Program& program) const;
+  static std::string defaultDirectory();
+  private:
+  std::string directory;
+  uint32_t format;
+  std::string path(uint64_t key) const;
+};
+
+uint64_t sourceHash(const std::string& source, uint32_t format = ProgramCache::currentFormat);
+std::string serialize(const Program& program);
+void deserialize(const char* data, size_t size, Program& program);
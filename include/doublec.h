@@ -0,0 +1,70 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+
+struct Program;
+class ProgramCache;
+class TraceBuffer;
+class MemoryTracker;
+
+namespace doublec{
+  // A parsed program. Apart from lazy bodies parsed once on first use, it is never modified after compile(),
+  // so one instance can run in many contexts and threads at once.
+  class CompiledProgram{
+    public:
+    explicit CompiledProgram(std::unique_ptr <Program> root);
+    ~CompiledProgram();
+    const Program& program() const;
+    private:
+    std::unique_ptr <Program> root;
+  };
+
+  enum class Parsing{
+    Eager,
+    // Block bodies are parsed when they first run; a validation pass still finds every syntax error before running.
+    Lazy,
+    // As Lazy, but a syntax error in a body is only reported when the body first runs.
+    LazyUnchecked
+  };
+
+  // Throws std::invalid_argument on syntax errors. Lazy parsing does not use the cache.
+  std::shared_ptr <const CompiledProgram> compile(const std::string& source, const ProgramCache* cache = nullptr, Parsing parsing = Parsing::Eager);
+  std::string readSource(const std::string& path);
+
+  // Bounds on one run, zero meaning unbounded; the timeout counts from the start of the run.
+  struct Limits{
+    uint64_t steps = 0;
+    std::chrono::duration <double> timeout{0};
+    std::chrono::steady_clock::time_point deadline() const;
+  };
+
+  // Per-run settings; every run() starts with fresh variables.
+  class Context{
+    public:
+    Context(std::istream& in = std::cin, std::ostream& out = std::cout);
+    void setTrace(TraceBuffer* buffer);
+    void setMemoryTracker(MemoryTracker* tracker);
+    void setLimits(const Limits& limits);
+    void run(const CompiledProgram& program);
+    // Runs the program once per input line, with the line bound to "line" and its 1-based number to "nr".
+    // Globals are cleared between lines unless keepState is set, and `begin` runs once first so it can set them up.
+    // in() reads nothing in this mode.
+    void runEachLine(const CompiledProgram& program, bool keepState = false, const CompiledProgram* begin = nullptr);
+    // Lexes and parses `source` on two more threads and runs each top-level statement as soon as it is parsed.
+    // A syntax error is thrown when the parser reaches it, after the statements before it have run.
+    void runPipelined(const std::string& source);
+    private:
+    std::istream* in;
+    std::ostream* out;
+    TraceBuffer* trace = nullptr;
+    MemoryTracker* tracker = nullptr;
+    Limits limits;
+  };
+
+  // Writes the message the command line prints for the error and returns its exit code.
+  int formatError(const std::exception_ptr& error, std::string& message);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+// A whole file mapped read-only; words and lines are handed out as views into the mapping, so the file is never copied.
+class MappedFile{
+  public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  // The next whitespace-separated word, or an empty view at the end of the file.
+  std::string_view word();
+  // The next line without its "\n" or "\r\n"; an empty view at the end of the file.
+  std::string_view line();
+  std::string_view contents() const { return {data, size}; }
+  bool atEnd() const { return pos == size; }
+  private:
+  const char* data = nullptr;
+  size_t size = 0;
+  size_t pos = 0;
+};
+
+// An output stream writing to a file through a large buffer with write(2); flushed when closed or destroyed.
+class FileWriter : public std::ostream{
+  public:
+  explicit FileWriter(const std::string& path);
+  ~FileWriter();
+  // Flushes and closes the file; throws if any write failed.
+  void close();
+  private:
+  class Sink : public std::streambuf{
+    public:
+    int file = -1;
+    bool failed = false;
+    std::string storage;
+    bool drain();
+    protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* text, std::streamsize count) override;
+    int sync() override;
+  };
+  Sink buffer;
+  std::string path;
+};
@@ -1,10 +1,20 @@
 #pragma once
 #include "AST.h"
+#include "map.h"
+#include "bigint.h"
+#include "trace.h"
+#include "fileio.h"
+#include <array>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <map>
+#include <memory>
 #include <unordered_map>
+#include <string_view>
 #include <cmath>
+#include <sstream>
 
 class interpreter_error : public std::runtime_error{
   public:
@@ -12,37 +22,200 @@ class interpreter_error : public std::runtime_error{
   interpreter_error(const std::string& msg, size_t line, size_t column = 0);
 };
 
+using Scope = std::unordered_map <std::string, Value, std::hash<std::string>, std::equal_to<std::string>, CountingAllocator<std::pair<const std::string, Value>, MemoryCategory::Scopes>>;
+
+class InputChannel;
+
+// Locals of the active function calls. Each call takes one contiguous block of slots; blocks are carved from chunks
+// that never move, so a Value* into a caller's locals stays valid while the callee runs.
+class CallStack{
+  public:
+  Value* push(size_t count);
+  void pop(Value* block, size_t count);
+  private:
+  struct Chunk{
+    std::unique_ptr<Value[]> slots;
+    size_t size = 0;
+    size_t used = 0;
+  };
+  std::vector<Chunk> chunks;
+  size_t current = 0;
+};
+
 class Interpreter{
   public:
+  enum class RunState{
+    Finished,
+    Preempted,
+    Waiting
+  };
   void execute(const Program& program);
+  // start() then resume() run a program in slices; resume() stops after `budget` statements and loop iterations,
+  // or before an in() whose channel has no complete word yet. Starting at `next` runs only statements appended since.
+  void start(const Program& program, size_t next = 0);
+  RunState resume(size_t budget);
+  void setTrace(TraceBuffer* buffer);
+  void setStreams(std::istream& input, std::ostream& output);
+  void setInput(InputChannel* input);
+  // Called once per resume() when a function call cannot stop where resume() would: it outlasts the budget or
+  // reads from a channel with no word yet. The call then runs on, and resume() returns Preempted after it.
+  void onStall(std::function<void()> callback);
+  // Stops the run with an error after `steps` statements and loop iterations (0 = unbounded) or once `deadline` passes.
+  // The clock is read every meterInterval steps, so a deadline is noticed within that many steps.
+  void setLimits(uint64_t steps, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+  static constexpr uint64_t meterInterval = 1024;
+  // Sets a global variable before the program starts; reset() keeps bound variables and drops everything else.
+  void bind(const std::string& name, Value value);
+  void bind(const std::string& name, std::string_view text);
+  void reset();
+  // Keeps top-level variables alive after their last use, for programs that run again with the same globals.
+  void setKeepGlobals(bool keep);
+  // Calls nest at most this deep, and never closer than a safety margin to the end of the native stack.
+  static constexpr size_t maxCallDepth = 10000;
   private:
-  std::vector<std::unordered_map <std::string, Value>> variables;
+  struct Frame{
+    const Program* body;
+    size_t next = 0;
+    bool scoped = true;
+    const Statement* loop = nullptr;
+    Value* iterator = nullptr;
+    int64_t Final = 0;
+    short direction = 0;
+  };
+  TraceBuffer* trace = nullptr;
+  Interpreter* parent = nullptr;
+  std::istream* in = &std::cin;
+  std::ostream* out = &std::cout;
+  InputChannel* channel = nullptr;
+  std::function<void()> stallHandler;
+  // Statements left in this resume(); a stalled run is preempted once it is back at the top level.
+  size_t budget = 0;
+  bool stalled = false;
+  // Set by open_input() and open_output(); in(), readline() and out() use them instead of the streams while open.
+  std::unique_ptr<MappedFile> inputFile;
+  std::unique_ptr<FileWriter> outputFile;
+  std::ostream* console = nullptr;
+  // Slots of the running call, or nullptr outside functions; returning unwinds `frames` down to `callFloor`.
+  CallStack stack;
+  Value* locals = nullptr;
+  size_t callFloor = 0;
+  size_t depth = 0;
+  Value returned{Datatype::Invalid, {}};
+  std::unordered_map<std::string, const Function*> functions;
+  std::unordered_map<const Function*, std::unordered_map<std::string, Value>> memo;
+  std::vector<Scope, CountingAllocator<Scope, MemoryCategory::Scopes>> variables;
+  std::vector<Frame> frames;
+  std::vector<std::string> bound;
+  bool keepGlobals = false;
+  // Steps before the next limit check, and the steps left after those; each statement and loop iteration takes one.
+  static constexpr uint64_t unmetered = UINT64_MAX / 2;
+  // DOUBLEC_UNMETERED drops the per-step check, so benchmarks can measure what metering costs; limits then never fire.
+#ifdef DOUBLEC_UNMETERED
+  static constexpr bool metered = false;
+#else
+  static constexpr bool metered = true;
+#endif
+  uint64_t fuel = meterInterval;
+  uint64_t reserve = unmetered;
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  void refuel(const Location& location);
+  void enter(const Program& body, const Statement* loop = nullptr);
+  bool repeat(size_t index);
   Value* findVar(const std::string& name);
+  Value* findVar(const std::string& name, int slot);
+  Value& declare(const std::string& name, int slot);
+  RunState run(size_t floor);
+  void stall();
+  const Function* findFunction(const std::string& name);
+  void functionDefinition(const Function& stmt);
+  void returnStatement(const Return& stmt);
+  Value invoke(const Function& function, const Call& expr);
+  Value* findLocal(const std::string& name);
   void matchStatement(const Statement& stmt);
   void input(const Input& stmt);
+  String readWord();
   void output(const Output& stmt);
   void definition(const Definition& stmt);
+  void update(const Update& stmt);
+  void release(const Release& stmt);
+  bool condition(const Expression& expr);
+  void elementDefinition(const ElementDefinition& stmt);
+  void callStatement(const CallStatement& stmt);
   void whileloop(const While& stmt);
   void forloop(const For& stmt);
-  void forbody(Value*& Initial, const short& direction, const For& stmt);
+  void forstep(Value*& Initial, const short& direction, const For& stmt);
+  bool forCondition(const For& stmt, int64_t current, int64_t Final, short direction);
+  void parallelFor(const For& stmt, Value*& Initial, int64_t Final, short direction);
   void ifStatement(const IfStatement& stmt);
+  void switchStatement(const Switch& stmt);
   double toDouble(const Value& value);
   int64_t toInt(const Value& value);
+  static bool isBig(const Value& value);
+  BigInt toBig(const Value& value);
+  static Value normalize(BigInt value);
   std::string toString(const Value& value);
   char toChar(const Value& value);
-  Value convertString(const Cast& expr);
+  void appendString(String& target, const Value& value);
+  bool appendInPlace(const Definition& stmt, Cow<String>& target);
+  Value convertString(const Cast& expr, const Value& b);
   bool isNumeric(const Value& value);
   bool isTrue (const Value& value);
   Value eval(const Expression& expr);
-  Value evalAdd(const Value& left, const Value& right);
-  Value evalSub(const Value& left, const Value& right);
-  Value evalMul(const Value& left, const Value& right);
-  Value evalDiv(const Value& left, const Value& right);
-  Value evalMod(const Value& left, const Value& right);
-  Value evalGr(const Value& left, const Value& right);
-  Value evalLs(const Value& left, const Value& right);
-  Value evalEq(const Value& left, const Value& right);
-  Value evalNq(const Value& left, const Value& right);
-  Value evalGe(const Value& left, const Value& right);
-  Value evalLe(const Value& left, const Value& right);
+  const Value& borrow(const Expression& expr, Value& temporary);
+  const Value* reference(const Expression& expr);
+  // Native functions callable from scripts, looked up by name; the argument count is checked before the call.
+  struct Builtin{
+    Value (Interpreter::*function)(const Call& expr);
+    size_t minArguments;
+    size_t maxArguments;
+  };
+  static const std::unordered_map <std::string_view, Builtin>& builtins();
+  Value call(const Call& expr);
+  Value callLen(const Call& expr);
+  Value callContains(const Call& expr);
+  Value callErase(const Call& expr);
+  Value callArray(const Call& expr);
+  Value callReduce(const Call& expr);
+  Value callExtreme(const Call& expr);
+  Value callSort(const Call& expr);
+  Value callBinarySearch(const Call& expr);
+  Value callReverse(const Call& expr);
+  Value callSplit(const Call& expr);
+  Value callJoin(const Call& expr);
+  Value callOpenInput(const Call& expr);
+  Value callOpenOutput(const Call& expr);
+  Value callCloseInput(const Call& expr);
+  Value callCloseOutput(const Call& expr);
+  Value callReadline(const Call& expr);
+  Value callEof(const Call& expr);
+  Value callReadFile(const Call& expr);
+  std::string fileName(const Call& expr);
+  void closeOutput();
+  bool lessThan(const Value& left, const Value& right);
+  void checkOrdered(const std::string& name, const ValueArray& values);
+  void print(std::ostream& stream, const Value& value);
+  Array makeArray(ValueArray&& values);
+  Array& asArray(Value& value);
+  const Array& asArray(const Value& value);
+  size_t toIndex(const Array& array, const Value& index);
+  Map& asMap(Value& value);
+  const Map& asMap(const Value& value);
+  Value lookup(const Map& map, const Value& key);
+  Value getElement(const Array& array, size_t index);
+  void setElement(Array& array, size_t index, Value&& value);
+  void boxArray(Array& array);
+  Value evalArray(Operator op, const char* symbol, const Value& left, const Value& right);
+  Value reduce(const std::string& name, const Value& value);
+  // Binary operators go through one table indexed by operator, left type and right type, filled at compile time
+  // with a handler specialized for each combination; see operators.cpp.
+  using BinaryHandler = Value (*)(Interpreter& self, const Value& left, const Value& right);
+  static constexpr size_t operatorCount = static_cast<size_t> (Operator::Invalid) + 1;
+  static constexpr size_t typeCount = static_cast<size_t> (Datatype::Invalid) + 1;
+  static const std::array <BinaryHandler, operatorCount * typeCount * typeCount> binaryHandlers;
+  template <Operator op, Datatype leftType, Datatype rightType>
+  static Value binary(Interpreter& self, const Value& left, const Value& right);
+  Value evalBinary(Operator op, const Value& left, const Value& right){
+    auto index = (static_cast<size_t> (op) * typeCount + static_cast<size_t> (left.type)) * typeCount + static_cast<size_t> (right.type);
+    return binaryHandlers[index](*this, left, right);
+  }
 };
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "AST.h"
+
+// Whole-array kernels with AVX2/SSE2 paths chosen at runtime and a scalar fallback.
+// An operand flagged as scalar is broadcast against the other one.
+namespace kernels{
+  const char* isa();
+  // Forces the "scalar", "sse2" or "avx2" path, for benchmarks; false when the name is unknown or the CPU lacks it.
+  // Not safe while kernels run on other threads.
+  bool select(const char* name);
+  void arithmetic(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, double* result, size_t size);
+  void arithmetic(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, int64_t* result, size_t size);
+  void compare(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, char* result, size_t size);
+  void compare(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, char* result, size_t size);
+  double sum(const double* data, size_t size);
+  int64_t sum(const int64_t* data, size_t size);
+  double min(const double* data, size_t size);
+  int64_t min(const int64_t* data, size_t size);
+  double max(const double* data, size_t size);
+  int64_t max(const int64_t* data, size_t size);
+  size_t count(const char* data, size_t size);
+}
@@ -7,7 +7,7 @@
 #include <cctype>
 #include <cstdint>
 #include <stdexcept>
-#include <fstream>
+#include <sstream>
 
 enum class TokenType{
     Identifier,
@@ -37,6 +37,10 @@ enum class Keyword : uint8_t {
     String,
     While,
     For,
+    Parallel,
+    Func,
+    Pure,
+    Return,
     amount
 };
 
@@ -51,12 +55,12 @@ struct Token{
 
 class Lexer{
   static constexpr std::array <std::string_view, static_cast <size_t> (Keyword::amount)> keywords {
-        "if", "else", "true", "false", "in", "out","double", "int", "char", "bool", "string", "while", "for"
+        "if", "else", "true", "false", "in", "out","double", "int", "char", "bool", "string", "while", "for", "parallel", "func", "pure", "return"
   };
   Keyword IsKeyword(const std::string_view lexeme);
   std::vector <std::string> Initialcode;
   std::vector <std::vector <Token>> tokens;
-  size_t i;
+  size_t i = 0;
   size_t pos;
   bool isLetter();
   bool isDigit();
@@ -65,8 +69,12 @@ class Lexer{
   bool isSeparator();
   char getEscapes(const char& c);
   void unexEnd();
+  void TokenizeLine();
   public:
   std::vector <std::vector <Token>> Tokenize();
-  void readFile(std::string name);
+  // Tokenizes the next `lines` source lines, for handing the tokens on in batches; blank lines yield no tokens.
+  std::vector <std::vector <Token>> Tokenize(size_t lines);
+  bool done() const;
+  void load(const std::string& source);
 };
 
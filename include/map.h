@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "AST.h"
+
+// Open-addressing hash table in the Swiss-table layout: one control byte per slot holds the low 7 bits of the hash,
+// and lookups compare a group of 16 control bytes at once (SSE2 when available, scalar otherwise).
+// Keys are int, char, bool or string values; int, char and bool keys that are == to each other are the same key.
+// Slots only hold the position of an entry; entries are kept densely in insertion order, which is also the print order.
+// Every entry keeps the full hash of its key, so strings are hashed once and never rehashed when the table grows.
+class Map {
+  public:
+  struct Entry {
+    uint64_t hash = 0;
+    Value key;
+    Value value;
+  };
+  static bool validKey(const Value& key);
+  size_t size() const { return count; }
+  const Value* find(const Value& key) const;
+  Value* find(const Value& key);
+  // Returns the value stored under `key`, inserting a default one first when the key is new.
+  Value& insert(const Value& key);
+  bool erase(const Value& key);
+  template <typename F>
+  void forEach(F&& visit) const {
+    for(const auto& entry : entries){
+      if(entry.key.type != Datatype::Invalid) visit(entry.key, entry.value);
+    }
+  }
+  private:
+  Buffer <int8_t> control;
+  Buffer <uint32_t> positions;
+  Buffer <Entry> entries;
+  size_t count = 0;
+  size_t growthLeft = 0;
+  size_t locate(const Value& key, uint64_t hash) const;
+  size_t available(uint64_t hash) const;
+  void rehash(size_t capacity);
+};
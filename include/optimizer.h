@@ -0,0 +1,9 @@
+#pragma once
+#include "AST.h"
+
+// Rewrites a parsed program in place; the result runs with the same semantics.
+void optimize(Program& program);
+void optimize(std::unique_ptr <Statement>& stmt);
+// Inserts a Release after the last statement of each block that uses a variable the block itself assigns. Only for whole programs and
+// block bodies: a top-level statement run on its own may be followed by others that still use its variables.
+void releaseDeadVariables(Program& program);
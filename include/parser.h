@@ -2,31 +2,67 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 #include "lexer.h"
 #include "AST.h"
+#include "pipeline.h"
 #define OPENBRACKET "Expected \"(\""
 #define CLOSEBRACKET "Expected \")\""
 #define CURLYBRACKET "Expected \"{\""
+#define CLOSESQUAREBRACKET "Expected \"]\""
 class Parser {
     private:
     size_t line = 0;
     size_t pos = 0;
     void SyntaxErr(const std::string& err);
     const Token& peek() const;
+    const Token& peekNext() const;
     Token& advance();
     std::vector <std::vector <Token>>& tokens;
+    BoundedQueue <std::vector <std::vector <Token>>>* source = nullptr;
+    size_t released = 0;
+    std::exception_ptr failure;
+    std::shared_ptr <std::vector <std::vector <Token>>> shared;
+    bool lazy = false;
+    std::vector <std::pair <size_t, size_t>> deferred;
+    // Waits for line `index` when streaming; a lexer error is rethrown once the parser needs a line past it, unless `rethrow` is false.
+    bool available(size_t index, bool rethrow = true);
+    std::vector <std::unordered_set <std::string>> scopes{{}};
+    const Function* function = nullptr;
+    std::unordered_map <std::string, int> slots;
+    // Functions parsed so far and whether they are pure, and the first call from a pure body to each one not parsed yet.
+    std::unordered_map <std::string, bool> purity;
+    std::unordered_map <std::string, Location> pureCalls;
+    void declare(const std::string& name);
+    bool isDeclared(const std::string& name) const;
+    void checkParallelBody(const Program& body, const For& loop);
     std::unique_ptr <Statement> MakeStatement();
     std::unique_ptr <Statement> ParseInput();
     std::unique_ptr <Statement> ParseOutput();
     std::unique_ptr <Statement> ParseDefinition();
+    std::unique_ptr <Statement> ParseElementDefinition();
     std::unique_ptr <Statement> ParseIfStatement();
     std::unique_ptr <Statement> ParseWhile();
     std::unique_ptr <Statement> ParseFor();
+    std::unique_ptr <Statement> ParseParallelFor();
+    std::unique_ptr <Statement> ParseCallStatement();
+    std::unique_ptr <Statement> ParseFunction();
+    std::unique_ptr <Statement> ParseReturn();
+    int slotOf(const std::string& name);
+    void resolveSlots(Program& body, const Function& owner);
+    void resolveSlots(Expression& expr, const Function& owner);
+    void checkPureCall(const Call& call, const Function& owner);
     std::unique_ptr <Expression> ParseMidTerm();
     std::unique_ptr <Expression> MakeExpression();
     std::unique_ptr <Expression> ParseTerm();
     std::unique_ptr <Expression> SingleParse();
+    std::unique_ptr <Expression> ParsePostfix(std::unique_ptr <Expression> expr);
+    std::unique_ptr <Expression> ParseCall();
+    bool isCall();
     std::unique_ptr <Program> MakeBody();
+    std::unique_ptr <Program> DeferBody();
     bool Check(TokenType type);
     bool Check(std::string lexeme);
     bool Check(Keyword keyword);
@@ -34,9 +70,17 @@ class Parser {
     bool eatEnd();
     Datatype getDatatype(const TokenType& tokentype);
     Datatype getDatatype(const Keyword& keyword);
-    std::variant <int64_t, char, std::string, double, bool, std::vector <Value>> getData(); 
+    ValueData getData(); 
     Operator GetOperator(const std::string& op);
     public:
     Parser(std::vector <std::vector <Token>>& T);
+    // Takes its lines from `lines` as the lexer produces them, appending them to T; lines of finished statements are freed.
+    Parser(std::vector <std::vector <Token>>& T, BoundedQueue <std::vector <std::vector <Token>>>& lines);
     void Parse(Program& program);
+    // Hands each top-level statement to `emit` as soon as it is parsed.
+    void Parse(const std::function <void(std::unique_ptr <Statement>)>& emit);
+    // With `lazy`, if/while/for bodies outside functions and parallel loops are only brace-matched; see LazyProgram.
+    Parser(std::shared_ptr <std::vector <std::vector <Token>>> T, bool lazy);
+    // Parses every body deferred by Parse() in full and drops the result, so syntax errors surface before the script runs.
+    void Validate();
 };
@@ -0,0 +1,59 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Hands items from one producer thread to one consumer thread; the producer blocks while `capacity` items are waiting.
+template <typename T>
+class BoundedQueue{
+  public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+  // False once the consumer has closed the queue, so the producer can stop early.
+  bool push(T item){
+    std::unique_lock guard(lock);
+    space.wait(guard, [&](){ return items.size() < capacity || closed; });
+    if(closed) return false;
+    items.push_back(std::move(item));
+    ready.notify_one();
+    return true;
+  }
+  // Called by the producer when it is done; a non-null error is rethrown by pop() after the remaining items.
+  void finish(std::exception_ptr failure = nullptr){
+    std::lock_guard guard(lock);
+    finished = true;
+    error = failure;
+    ready.notify_one();
+  }
+  // Moves every waiting item into `out`, blocking until there is one. False when the producer has finished.
+  bool pop(std::vector <T>& out){
+    std::unique_lock guard(lock);
+    ready.wait(guard, [&](){ return !items.empty() || finished; });
+    if(items.empty()){
+      if(error) std::rethrow_exception(error);
+      return false;
+    }
+    for(auto& item : items) out.push_back(std::move(item));
+    items.clear();
+    space.notify_one();
+    return true;
+  }
+  // Called by the consumer when it stops early; wakes a producer blocked in push().
+  void close(){
+    std::lock_guard guard(lock);
+    closed = true;
+    space.notify_one();
+  }
+  private:
+  std::mutex lock;
+  std::condition_variable ready;
+  std::condition_variable space;
+  std::deque <T> items;
+  size_t capacity;
+  bool finished = false;
+  bool closed = false;
+  std::exception_ptr error;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "doublec.h"
+#include "interpreter.h"
+
+// Words written by the host and read by in(). A script reading from an empty channel is suspended, not blocked,
+// unless the read is inside a function call: that cannot be suspended, so read() waits for the word.
+class InputChannel{
+  public:
+  void write(std::string_view text);
+  void close();
+  // Wakes a waiting read() with an error; used when the scheduler stops while a call still waits.
+  void abandon();
+  // True once a whole word is buffered, or the channel is closed and in() would read an empty string.
+  bool ready();
+  void read(String& word);
+  void onData(std::function <void()> callback);
+  private:
+  std::mutex lock;
+  std::condition_variable arrived;
+  std::string buffer;
+  size_t pos = 0;
+  bool closed = false;
+  bool abandoned = false;
+  std::function <void()> notify;
+  size_t wordEnd();
+};
+
+class Task{
+  public:
+  ~Task();
+  InputChannel input;
+  bool done() const { return finished.load(std::memory_order_acquire); }
+  // Exit code and message as doublec::formatError() reports them; valid once done().
+  int code() const { return result; }
+  const std::string& error() const { return message; }
+  private:
+  friend class Scheduler;
+  enum class State{
+    Queued,
+    Running,
+    Waiting,
+    Done
+  };
+  State state = State::Queued;
+  bool notified = false;
+  MemoryTracker tracker;
+  std::unique_ptr <Interpreter> interpreter;
+  std::shared_ptr <const doublec::CompiledProgram> program;
+  int result = 0;
+  std::string message;
+  std::atomic <bool> finished{false};
+};
+
+// Runs many scripts on a few worker threads. A script gives up its worker after `slice` statements
+// or when it waits for input, and is queued again when preempted or when its input arrives.
+// A function call runs to its end on one worker: when it outlasts the slice or waits for input, another worker
+// stands in for it until it returns, and the script is preempted as soon as it is back at the top level.
+class Scheduler{
+  public:
+  explicit Scheduler(size_t workers = 0, size_t slice = 10000);
+  ~Scheduler();
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+  // The task's timeout counts from the spawn, so time spent queued behind other tasks is included.
+  // When `input` is given it is written to the task's channel, and the channel closed, before the task can run.
+  std::shared_ptr <Task> spawn(std::shared_ptr <const doublec::CompiledProgram> program, std::ostream& out, size_t memoryLimit = 0, TraceBuffer* trace = nullptr, const doublec::Limits& limits = {}, const std::string* input = nullptr);
+  // Returns once every spawned task is done; tasks waiting on an open channel keep it blocked.
+  void wait();
+  private:
+  std::mutex lock;
+  std::condition_variable ready;
+  std::condition_variable idle;
+  std::deque <std::shared_ptr <Task>> queue;
+  size_t pending = 0;
+  size_t slice;
+  bool stopping = false;
+  std::vector <std::thread> threads;
+  // Workers wanted, workers alive, and the tasks whose calls hold a worker past their slice.
+  size_t workers;
+  size_t active = 0;
+  std::vector <std::shared_ptr <Task>> stalled;
+  // Stand-in workers that have returned and are waiting to be joined.
+  std::vector <std::thread::id> retired;
+  void wake(const std::shared_ptr <Task>& task);
+  void stall(const std::shared_ptr <Task>& task);
+  void workerLoop();
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class ThreadPool{
+  public:
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  // Runs task(0..count-1) on the pool and the calling thread, returns when all are done.
+  // Called from inside a task, or while another run is in progress, it runs inline instead.
+  void run(size_t count, const std::function <void(size_t)>& task);
+  size_t size() const;
+  static ThreadPool& shared();
+  private:
+  struct Queue{
+    std::mutex lock;
+    std::deque <std::pair <size_t, size_t>> ranges;
+  };
+  std::vector <std::thread> threads;
+  std::vector <std::unique_ptr <Queue>> queues;
+  std::mutex runLock;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  const std::function <void(size_t)>* job = nullptr;
+  uint64_t generation = 0;
+  std::atomic <size_t> remaining{0};
+  std::exception_ptr error;
+  bool stopping = false;
+  void workerLoop(size_t id);
+  bool runOne(size_t id);
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "AST.h"
+
+enum class TraceKind : uint8_t {
+  Output,
+  Input,
+  Definition,
+  If,
+  While,
+  For,
+  Iteration,
+  amount
+};
+
+struct TraceRecord{
+  uint32_t line;
+  uint16_t column;
+  uint8_t kind;
+  uint8_t tag;
+  int64_t payload;
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records are expected to be 16 bytes");
+
+class TraceBuffer{
+  public:
+  explicit TraceBuffer(size_t capacity);
+  void record(TraceKind kind, const Location& location, Datatype tag = Datatype::Invalid, int64_t payload = 0){
+    auto& slot = records[head.fetch_add(1, std::memory_order_relaxed) & mask];
+    slot.line = static_cast <uint32_t> (location.line);
+    slot.column = location.column > UINT16_MAX ? UINT16_MAX : static_cast <uint16_t> (location.column);
+    slot.kind = static_cast <uint8_t> (kind);
+    slot.tag = static_cast <uint8_t> (tag);
+    slot.payload = payload;
+  }
+  void record(TraceKind kind, const Location& location, const Value& value);
+  void dump(const std::string& path) const;
+  static std::vector <TraceRecord> load(const std::string& path, uint64_t& total);
+  private:
+  std::unique_ptr <TraceRecord[]> records;
+  size_t mask;
+  std::atomic <uint64_t> head{0};
+};
+
+const char* traceKindName(uint8_t kind);
+const char* datatypeName(uint8_t tag);
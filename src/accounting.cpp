@@ -0,0 +1,81 @@
+#include "accounting.h"
+#include "AST.h"
+#include <iomanip>
+
+memory_limit_error::memory_limit_error(const std::string& msg) : std::runtime_error(msg) {}
+
+MemoryTracker*& MemoryTracker::active(){
+  static thread_local MemoryTracker* tracker = nullptr;
+  return tracker;
+}
+
+static void raisePeak(std::atomic <int64_t>& peak, int64_t value){
+  auto old = peak.load(std::memory_order_relaxed);
+  while(value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed)) {}
+}
+
+void MemoryTracker::allocate(MemoryCategory category, size_t bytes){
+  auto id = static_cast <size_t> (category);
+  auto total = totalBytes.fetch_add(bytes, std::memory_order_relaxed) + static_cast <int64_t> (bytes);
+  if(limit != 0 && total > static_cast <int64_t> (limit)){
+    totalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    throw memory_limit_error("Memory limit of " + std::to_string(limit) + " bytes exceeded");
+  }
+  raisePeak(totalPeakBytes, total);
+  raisePeak(peakBytes[id], currentBytes[id].fetch_add(bytes, std::memory_order_relaxed) + static_cast <int64_t> (bytes));
+}
+
+void MemoryTracker::release(MemoryCategory category, size_t bytes){
+  currentBytes[static_cast <size_t> (category)].fetch_sub(bytes, std::memory_order_relaxed);
+  totalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+int64_t MemoryTracker::current(MemoryCategory category) const{
+  return currentBytes[static_cast <size_t> (category)].load(std::memory_order_relaxed);
+}
+
+int64_t MemoryTracker::peak(MemoryCategory category) const{
+  return peakBytes[static_cast <size_t> (category)].load(std::memory_order_relaxed);
+}
+
+int64_t MemoryTracker::total() const{
+  return totalBytes.load(std::memory_order_relaxed);
+}
+
+int64_t MemoryTracker::totalPeak() const{
+  return totalPeakBytes.load(std::memory_order_relaxed);
+}
+
+void MemoryTracker::report(std::ostream& out) const{
+  static constexpr std::array <const char*, static_cast <size_t> (MemoryCategory::amount)> names {"values", "scopes", "ast"};
+  out << "Memory usage (bytes)" << std::setw(14) << "current" << std::setw(14) << "peak" << '\n';
+  for(size_t i = 0; i < names.size(); i++){
+    auto category = static_cast <MemoryCategory> (i);
+    out << "  " << std::left << std::setw(18) << names[i] << std::right << std::setw(14) << current(category) << std::setw(14) << peak(category) << '\n';
+  }
+  out << "  " << std::left << std::setw(18) << "total" << std::right << std::setw(14) << total() << std::setw(14) << totalPeak() << '\n';
+  if(limit != 0) out << "  limit: " << limit << '\n';
+}
+
+void* AST::operator new(size_t size){
+  if(auto tracker = MemoryTracker::active()) tracker->allocate(MemoryCategory::AST, size);
+  return ::operator new(size);
+}
+
+void AST::operator delete(void* ptr, size_t size){
+  if(auto tracker = MemoryTracker::active()) tracker->release(MemoryCategory::AST, size);
+  ::operator delete(ptr);
+}
+
+size_t parseMemorySize(const std::string& text){
+  size_t end = 0;
+  unsigned long long value = std::stoull(text, &end);
+  if(end == text.size()) return value;
+  if(end + 1 != text.size()) throw std::invalid_argument(text);
+  switch(text[end]){
+    case 'k': case 'K': return value << 10;
+    case 'm': case 'M': return value << 20;
+    case 'g': case 'G': return value << 30;
+    default: throw std::invalid_argument(text);
+  }
+}
@@ -0,0 +1,86 @@
+#include "batch.h"
+#include "accounting.h"
+#include "threadpool.h"
+#include "scheduler.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace doublec{
+  std::vector <BatchJob> readManifest(const std::string& path){
+    std::ifstream in(path);
+    if(!in.is_open()) throw std::runtime_error("Cannot open the manifest " + path);
+    std::vector <BatchJob> jobs;
+    std::string line;
+    for(size_t number = 1; std::getline(in, line); number++){
+      std::istringstream fields(line);
+      BatchJob job;
+      if(!(fields >> job.script) || job.script[0] == '#') continue;
+      std::string extra;
+      if(!(fields >> job.input >> job.output) || fields >> extra) throw std::runtime_error("Invalid manifest entry at line " + std::to_string(number));
+      jobs.push_back(std::move(job));
+    }
+    return jobs;
+  }
+
+  std::vector <BatchResult> runBatch(const std::vector <BatchJob>& jobs, const ProgramCache* cache, size_t memoryLimit, TraceBuffer* trace, size_t slice, const Limits& limits){
+    std::unordered_map <std::string, size_t> scripts;
+    std::vector <const std::string*> paths;
+    for(const auto& job : jobs){
+      if(scripts.emplace(job.script, paths.size()).second) paths.push_back(&job.script);
+    }
+    auto previous = std::exchange(MemoryTracker::active(), nullptr);
+    std::vector <std::shared_ptr <const CompiledProgram>> programs(paths.size());
+    std::vector <std::exception_ptr> failures(paths.size());
+    ThreadPool::shared().run(paths.size(), [&](size_t index){
+      try{
+        programs[index] = compile(readSource(*paths[index]), cache);
+      }
+      catch(...){
+        failures[index] = std::current_exception();
+      }
+    });
+    std::vector <BatchResult> results(jobs.size());
+    std::vector <std::ostringstream> outputs(jobs.size());
+    std::vector <std::shared_ptr <Task>> tasks(jobs.size());
+    {
+      Scheduler scheduler(0, slice);
+      for(size_t index = 0; index < jobs.size(); index++){
+        auto& job = jobs[index];
+        try{
+          auto script = scripts.find(job.script)->second;
+          if(failures[script]) std::rethrow_exception(failures[script]);
+          std::string input;
+          if(job.input != "-") input = readSource(job.input);
+          tasks[index] = scheduler.spawn(programs[script], outputs[index], memoryLimit, trace, limits, &input);
+        }
+        catch(...){
+          results[index].code = formatError(std::current_exception(), results[index].error);
+        }
+      }
+      scheduler.wait();
+    }
+    for(size_t index = 0; index < jobs.size(); index++){
+      auto& job = jobs[index];
+      auto& result = results[index];
+      if(tasks[index]){
+        result.code = tasks[index]->code();
+        result.error = tasks[index]->error();
+      }
+      if(job.output == "-"){
+        result.output = outputs[index].str();
+        continue;
+      }
+      std::ofstream file(job.output, std::ios::binary);
+      file << outputs[index].str();
+      if(!file && result.code == 0){
+        result.code = -3;
+        result.error = "Runtime error: Cannot write the output file " + job.output;
+      }
+    }
+    MemoryTracker::active() = previous;
+    return results;
+  }
+}
@@ -0,0 +1,293 @@
+#include "bigint.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace{
+  using Limbs = Buffer <uint32_t>;
+  constexpr size_t karatsubaThreshold = 32;
+  constexpr uint32_t decimalBase = 1000000000;
+  constexpr size_t decimalDigits = 9;
+
+  void trimmed(Limbs& limbs){
+    while(!limbs.empty() && limbs.back() == 0) limbs.pop_back();
+  }
+
+  int compareMagnitude(const Limbs& left, const Limbs& right){
+    if(left.size() != right.size()) return left.size() < right.size() ? -1 : 1;
+    for(size_t i = left.size(); i-- > 0;){
+      if(left[i] != right[i]) return left[i] < right[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  // target += value << (32 * shift)
+  void addAt(Limbs& target, const Limbs& value, size_t shift){
+    if(target.size() < value.size() + shift) target.resize(value.size() + shift, 0);
+    uint64_t carry = 0;
+    size_t i = 0;
+    for(; i < value.size(); i++){
+      carry += uint64_t(target[i + shift]) + value[i];
+      target[i + shift] = static_cast <uint32_t> (carry);
+      carry >>= 32;
+    }
+    for(i += shift; carry; i++){
+      if(i == target.size()) target.push_back(0);
+      carry += target[i];
+      target[i] = static_cast <uint32_t> (carry);
+      carry >>= 32;
+    }
+  }
+
+  Limbs add(const Limbs& left, const Limbs& right){
+    Limbs result = left;
+    addAt(result, right, 0);
+    return result;
+  }
+
+  // left -= right, where left >= right
+  void subtractFrom(Limbs& left, const Limbs& right){
+    int64_t borrow = 0;
+    for(size_t i = 0; i < left.size(); i++){
+      int64_t difference = int64_t(left[i]) - borrow - (i < right.size() ? int64_t(right[i]) : 0);
+      borrow = difference < 0;
+      left[i] = static_cast <uint32_t> (difference);
+      if(i >= right.size() && !borrow) break;
+    }
+    trimmed(left);
+  }
+
+  Limbs slice(const Limbs& limbs, size_t begin, size_t end){
+    begin = std::min(begin, limbs.size());
+    Limbs result(limbs.begin() + begin, limbs.begin() + std::min(end, limbs.size()));
+    trimmed(result);
+    return result;
+  }
+
+  Limbs multiply(const Limbs& left, const Limbs& right){
+    if(left.empty() || right.empty()) return {};
+    if(std::min(left.size(), right.size()) < karatsubaThreshold){
+      Limbs result(left.size() + right.size(), 0);
+      for(size_t i = 0; i < left.size(); i++){
+        uint64_t carry = 0;
+        for(size_t j = 0; j < right.size(); j++){
+          carry += uint64_t(left[i]) * right[j] + result[i + j];
+          result[i + j] = static_cast <uint32_t> (carry);
+          carry >>= 32;
+        }
+        result[i + right.size()] = static_cast <uint32_t> (carry);
+      }
+      trimmed(result);
+      return result;
+    }
+    size_t half = std::max(left.size(), right.size()) / 2;
+    auto low = slice(left, 0, half), high = slice(left, half, left.size());
+    auto rightLow = slice(right, 0, half), rightHigh = slice(right, half, right.size());
+    auto z0 = multiply(low, rightLow);
+    auto z2 = multiply(high, rightHigh);
+    auto z1 = multiply(add(low, high), add(rightLow, rightHigh));
+    subtractFrom(z1, z0);
+    subtractFrom(z1, z2);
+    Limbs result = z0;
+    addAt(result, z1, half);
+    addAt(result, z2, 2 * half);
+    trimmed(result);
+    return result;
+  }
+
+  // Returns limbs << bits with one extra limb on top, for 0 <= bits < 32.
+  Limbs shifted(const Limbs& limbs, int bits){
+    Limbs result(limbs.size() + 1, 0);
+    for(size_t i = 0; i < limbs.size(); i++){
+      uint64_t wide = uint64_t(limbs[i]) << bits;
+      result[i] |= static_cast <uint32_t> (wide);
+      result[i + 1] = static_cast <uint32_t> (wide >> 32);
+    }
+    return result;
+  }
+
+  uint32_t divideSmall(Limbs& limbs, uint32_t divisor){
+    uint64_t rest = 0;
+    for(size_t i = limbs.size(); i-- > 0;){
+      rest = (rest << 32) | limbs[i];
+      limbs[i] = static_cast <uint32_t> (rest / divisor);
+      rest %= divisor;
+    }
+    trimmed(limbs);
+    return static_cast <uint32_t> (rest);
+  }
+
+  // Long division from Knuth, TAOCP vol. 2, 4.3.1, algorithm D.
+  Limbs remainderOf(const Limbs& dividend, const Limbs& divisor){
+    if(compareMagnitude(dividend, divisor) < 0) return dividend;
+    if(divisor.size() == 1){
+      Limbs quotient = dividend;
+      Limbs rest;
+      if(auto small = divideSmall(quotient, divisor[0])) rest.push_back(small);
+      return rest;
+    }
+    int bits = std::countl_zero(divisor.back());
+    auto v = shifted(divisor, bits);
+    v.pop_back();
+    auto u = shifted(dividend, bits);
+    size_t n = v.size();
+    for(size_t j = u.size() - n; j-- > 0;){
+      uint64_t numerator = (uint64_t(u[j + n]) << 32) | u[j + n - 1];
+      uint64_t estimate = numerator / v[n - 1];
+      uint64_t rest = numerator % v[n - 1];
+      while(estimate >> 32 || estimate * v[n - 2] > ((rest << 32) | u[j + n - 2])){
+        estimate--;
+        rest += v[n - 1];
+        if(rest >> 32) break;
+      }
+      int64_t borrow = 0;
+      uint64_t carry = 0;
+      for(size_t i = 0; i < n; i++){
+        carry += estimate * v[i];
+        int64_t difference = int64_t(u[i + j]) - borrow - int64_t(carry & 0xFFFFFFFF);
+        carry >>= 32;
+        u[i + j] = static_cast <uint32_t> (difference);
+        borrow = difference < 0;
+      }
+      int64_t top = int64_t(u[j + n]) - borrow - int64_t(carry);
+      u[j + n] = static_cast <uint32_t> (top);
+      if(top < 0){
+        uint64_t sum = 0;
+        for(size_t i = 0; i < n; i++){
+          sum += uint64_t(u[i + j]) + v[i];
+          u[i + j] = static_cast <uint32_t> (sum);
+          sum >>= 32;
+        }
+        u[j + n] += static_cast <uint32_t> (sum);
+      }
+    }
+    Limbs rest(n, 0);
+    for(size_t i = 0; i < n; i++){
+      rest[i] = bits == 0 ? u[i] : (u[i] >> bits) | static_cast <uint32_t> (uint64_t(u[i + 1]) << (32 - bits));
+    }
+    trimmed(rest);
+    return rest;
+  }
+}
+
+BigInt::BigInt(int64_t value) : sign(value < 0){
+  uint64_t magnitude = sign ? 0 - static_cast <uint64_t> (value) : static_cast <uint64_t> (value);
+  limbs.push_back(static_cast <uint32_t> (magnitude));
+  limbs.push_back(static_cast <uint32_t> (magnitude >> 32));
+  trim();
+}
+
+void BigInt::trim(){
+  trimmed(limbs);
+  if(limbs.empty()) sign = false;
+}
+
+BigInt BigInt::parse(std::string_view text){
+  BigInt result;
+  bool minus = !text.empty() && text[0] == '-';
+  if(minus) text.remove_prefix(1);
+  if(text.empty() || !std::all_of(text.begin(), text.end(), [](char c){ return c >= '0' && c <= '9'; })) throw std::invalid_argument("Not an integer");
+  size_t chunk = text.size() % decimalDigits == 0 ? decimalDigits : text.size() % decimalDigits;
+  for(size_t begin = 0; begin < text.size(); begin += chunk, chunk = decimalDigits){
+    uint64_t carry = 0;
+    for(size_t i = begin; i < begin + chunk; i++) carry = carry * 10 + (text[i] - '0');
+    uint64_t scale = 1;
+    for(size_t i = 0; i < chunk; i++) scale *= 10;
+    for(auto& limb : result.limbs){
+      carry += limb * scale;
+      limb = static_cast <uint32_t> (carry);
+      carry >>= 32;
+    }
+    if(carry) result.limbs.push_back(static_cast <uint32_t> (carry));
+  }
+  result.sign = minus;
+  result.trim();
+  return result;
+}
+
+bool BigInt::fits() const{
+  if(limbs.size() > 2) return false;
+  uint64_t magnitude = limbs.empty() ? 0 : limbs[0] | (limbs.size() > 1 ? uint64_t(limbs[1]) << 32 : 0);
+  return magnitude <= static_cast <uint64_t> (INT64_MAX) + sign;
+}
+
+int64_t BigInt::toInt64() const{
+  uint64_t magnitude = limbs.empty() ? 0 : limbs[0] | (limbs.size() > 1 ? uint64_t(limbs[1]) << 32 : 0);
+  return static_cast <int64_t> (sign ? 0 - magnitude : magnitude);
+}
+
+double BigInt::toDouble() const{
+  double result = 0;
+  for(size_t i = limbs.size(); i-- > 0;) result = result * 4294967296.0 + limbs[i];
+  return sign ? -result : result;
+}
+
+std::string BigInt::toString() const{
+  if(limbs.empty()) return "0";
+  Limbs rest = limbs;
+  std::vector <uint32_t> chunks;
+  while(!rest.empty()) chunks.push_back(divideSmall(rest, decimalBase));
+  std::string result = sign ? "-" : "";
+  result += std::to_string(chunks.back());
+  for(size_t i = chunks.size() - 1; i-- > 0;){
+    auto digits = std::to_string(chunks[i]);
+    result.append(decimalDigits - digits.size(), '0');
+    result += digits;
+  }
+  return result;
+}
+
+size_t BigInt::hash() const{
+  auto bytes = std::string_view(reinterpret_cast <const char*> (limbs.data()), limbs.size() * sizeof(uint32_t));
+  return std::hash <std::string_view> ()(bytes) ^ sign;
+}
+
+BigInt operator+(const BigInt& left, const BigInt& right){
+  BigInt result;
+  if(left.sign == right.sign){
+    result.limbs = add(left.limbs, right.limbs);
+    result.sign = left.sign;
+  }
+  else if(compareMagnitude(left.limbs, right.limbs) >= 0){
+    result.limbs = left.limbs;
+    subtractFrom(result.limbs, right.limbs);
+    result.sign = left.sign;
+  }
+  else{
+    result.limbs = right.limbs;
+    subtractFrom(result.limbs, left.limbs);
+    result.sign = right.sign;
+  }
+  result.trim();
+  return result;
+}
+
+BigInt operator-(const BigInt& left, const BigInt& right){
+  BigInt negated = right;
+  negated.sign = !negated.sign;
+  negated.trim();
+  return left + negated;
+}
+
+BigInt operator*(const BigInt& left, const BigInt& right){
+  BigInt result;
+  result.limbs = multiply(left.limbs, right.limbs);
+  result.sign = left.sign != right.sign;
+  result.trim();
+  return result;
+}
+
+BigInt operator%(const BigInt& left, const BigInt& right){
+  if(right.limbs.empty()) throw std::runtime_error("Division by zero is not permitted");
+  BigInt result;
+  result.limbs = remainderOf(left.limbs, right.limbs);
+  result.sign = left.sign;
+  result.trim();
+  return result;
+}
+
+int compare(const BigInt& left, const BigInt& right){
+  if(left.sign != right.sign) return left.sign ? -1 : 1;
+  auto magnitude = compareMagnitude(left.limbs, right.limbs);
+  return left.sign ? -magnitude : magnitude;
+}
@@ -0,0 +1,413 @@
+#include "interpreter.h"
+#include "threadpool.h"
+#include "kernels.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <iterator>
+
+static constexpr size_t parallelSortMinimum = 1 << 16;
+
+// Sorts equal chunks on the shared pool, then merges neighbouring runs pairwise until one run is left.
+template <typename T, typename Less>
+static void parallelSort(T* data, size_t size, Less less){
+  auto& pool = ThreadPool::shared();
+  if(size < parallelSortMinimum || pool.size() < 2){
+    std::sort(data, data + size, less);
+    return;
+  }
+  size_t chunks = std::min(std::bit_floor(pool.size() + 1), std::bit_floor(size / (parallelSortMinimum / 4)));
+  size_t width = (size + chunks - 1) / chunks;
+  pool.run(chunks, [&](size_t i){
+    auto begin = std::min(i * width, size);
+    std::sort(data + begin, data + std::min(begin + width, size), less);
+  });
+  Buffer <T> buffer(size);
+  T* from = data;
+  T* to = buffer.data();
+  for(; width < size; width *= 2){
+    pool.run((size + 2 * width - 1) / (2 * width), [&](size_t i){
+      auto begin = i * 2 * width;
+      auto middle = std::min(begin + width, size);
+      auto end = std::min(begin + 2 * width, size);
+      std::merge(std::make_move_iterator(from + begin), std::make_move_iterator(from + middle), std::make_move_iterator(from + middle), std::make_move_iterator(from + end), to + begin, less);
+    });
+    std::swap(from, to);
+  }
+  if(from != data) std::move(from, from + size, data);
+}
+
+static bool lessDouble(double left, double right){
+  return left < right || (right != right && left == left);
+}
+
+const std::unordered_map <std::string_view, Interpreter::Builtin>& Interpreter::builtins(){
+  static const std::unordered_map <std::string_view, Builtin> table{
+    {"len", {&Interpreter::callLen, 1, 1}},
+    {"contains", {&Interpreter::callContains, 2, 2}},
+    {"erase", {&Interpreter::callErase, 2, 2}},
+    {"array", {&Interpreter::callArray, 2, 2}},
+    {"sum", {&Interpreter::callReduce, 1, 1}},
+    {"count", {&Interpreter::callReduce, 1, 1}},
+    {"min", {&Interpreter::callExtreme, 1, SIZE_MAX}},
+    {"max", {&Interpreter::callExtreme, 1, SIZE_MAX}},
+    {"sort", {&Interpreter::callSort, 1, 1}},
+    {"binary_search", {&Interpreter::callBinarySearch, 2, 2}},
+    {"reverse", {&Interpreter::callReverse, 1, 1}},
+    {"split", {&Interpreter::callSplit, 1, 2}},
+    {"join", {&Interpreter::callJoin, 1, 2}},
+    {"open_input", {&Interpreter::callOpenInput, 1, 1}},
+    {"open_output", {&Interpreter::callOpenOutput, 1, 1}},
+    {"close_input", {&Interpreter::callCloseInput, 0, 0}},
+    {"close_output", {&Interpreter::callCloseOutput, 0, 0}},
+    {"readline", {&Interpreter::callReadline, 0, 0}},
+    {"eof", {&Interpreter::callEof, 0, 0}},
+    {"read_file", {&Interpreter::callReadFile, 1, 1}}
+  };
+  return table;
+}
+
+Value Interpreter::call(const Call& expr){
+  if(auto function = findFunction(expr.name)){
+    auto result = invoke(*function, expr);
+    if(result.type == Datatype::Invalid) throw interpreter_error("Function \"" + expr.name + "\" did not return a value", expr.location.line, expr.location.column);
+    return result;
+  }
+  auto found = builtins().find(expr.name);
+  if(found == builtins().end()) throw interpreter_error("No such function seems to be defined", expr.location.line, expr.location.column);
+  auto& builtin = found->second;
+  auto count = expr.arguments.size();
+  if(count < builtin.minArguments || count > builtin.maxArguments){
+    auto expected = std::to_string(builtin.minArguments);
+    if(builtin.maxArguments == SIZE_MAX) expected = "at least " + expected;
+    else if(builtin.maxArguments != builtin.minArguments) expected += " or " + std::to_string(builtin.maxArguments);
+    throw interpreter_error("Function \"" + expr.name + "\" expects " + expected + " argument(s)", expr.location.line, expr.location.column);
+  }
+  try{
+    return (this->*builtin.function)(expr);
+  }
+  catch(const interpreter_error&){
+    throw;
+  }
+  catch(const std::runtime_error& err){
+    throw interpreter_error(err.what(), expr.location.line, expr.location.column);
+  }
+}
+
+bool Interpreter::lessThan(const Value& left, const Value& right){
+  if(left.type == Datatype::String && right.type == Datatype::String) return *std::get<Cow<String>> (left.data) < *std::get<Cow<String>> (right.data);
+  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Only numbers or only strings can be compared");
+  if(left.type == Datatype::Double || right.type == Datatype::Double) return lessDouble(toDouble(left), toDouble(right));
+  if(isBig(left) || isBig(right)) return compare(toBig(left), toBig(right)) < 0;
+  return toInt(left) < toInt(right);
+}
+
+void Interpreter::checkOrdered(const std::string& name, const ValueArray& values){
+  if(values.empty()) return;
+  bool text = values[0].type == Datatype::String;
+  for(const auto& value : values){
+    if(text ? value.type != Datatype::String : !isNumeric(value)) throw std::runtime_error("Function \"" + name + "\" expects an array of numbers or of strings");
+  }
+}
+
+Value Interpreter::callLen(const Call& expr){
+  Value temporary;
+  auto& value = borrow(*expr.arguments[0], temporary);
+  if(value.type == Datatype::String) return {Datatype::Int, static_cast<int64_t> (std::get<Cow<String>> (value.data)->size())};
+  if(value.type == Datatype::Map) return {Datatype::Int, static_cast<int64_t> (std::get<Cow<Map>> (value.data)->size())};
+  return {Datatype::Int, static_cast<int64_t> (asArray(value).size())};
+}
+
+Value Interpreter::callContains(const Call& expr){
+  Value mapTemporary, keyTemporary;
+  auto& map = asMap(borrow(*expr.arguments[0], mapTemporary));
+  return {Datatype::Bool, map.find(borrow(*expr.arguments[1], keyTemporary)) != nullptr};
+}
+
+Value Interpreter::callErase(const Call&){
+  throw std::runtime_error("Function \"erase\" can only be used as a statement");
+}
+
+Value Interpreter::callArray(const Call& expr){
+  auto size = eval(*expr.arguments[0]);
+  if(size.type != Datatype::Int || toInt(size) < 0) throw std::runtime_error("The array size must be a non-negative integer");
+  auto value = eval(*expr.arguments[1]);
+  Array array;
+  array.type = isBig(value) ? Datatype::Invalid : value.type;
+  switch(array.type){
+    case Datatype::Int:
+      array.items = Buffer<int64_t> (toInt(size), std::get<int64_t> (value.data));
+      break;
+    case Datatype::Double:
+      array.items = Buffer<double> (toInt(size), std::get<double> (value.data));
+      break;
+    case Datatype::Char:
+      array.items = Buffer<char> (toInt(size), std::get<char> (value.data));
+      break;
+    case Datatype::Bool:
+      array.items = Buffer<char> (toInt(size), std::get<bool> (value.data));
+      break;
+    default:
+      array.type = Datatype::Invalid;
+      array.items = ValueArray(toInt(size), value);
+  }
+  return {Datatype::Array, std::move(array)};
+}
+
+Value Interpreter::callReduce(const Call& expr){
+  Value temporary;
+  return reduce(expr.name, borrow(*expr.arguments[0], temporary));
+}
+
+Value Interpreter::reduce(const std::string& name, const Value& value){
+  if(value.type != Datatype::Array) throw std::runtime_error("Function \"" + name + "\" expects an array");
+  auto& array = *std::get<Cow<Array>> (value.data);
+  if(name == "count"){
+    if(auto buffer = std::get_if<Buffer<char>> (&array.items)) return {Datatype::Int, static_cast<int64_t> (kernels::count(buffer->data(), buffer->size()))};
+    int64_t total = 0;
+    for(size_t i = 0; i < array.size(); i++) total += isTrue(getElement(array, i));
+    return {Datatype::Int, total};
+  }
+  if(array.size() == 0 && name != "sum") throw std::runtime_error("The array is empty");
+  bool hasDouble = array.type == Datatype::Double;
+  if(array.boxed()){
+    for(const auto& element : std::get<ValueArray> (array.items)){
+      if(!isNumeric(element)) throw std::runtime_error("Function \"" + name + "\" expects an array of numbers");
+      if(element.type == Datatype::Double) hasDouble = true;
+    }
+  }
+  auto run = [&]<typename T>(){
+    Buffer<T> storage;
+    const T* data;
+    if(auto buffer = std::get_if<Buffer<T>> (&array.items)) data = buffer->data();
+    else{
+      storage.reserve(array.size());
+      for(size_t i = 0; i < array.size(); i++){
+        if constexpr (std::is_same_v<T, double>) storage.push_back(toDouble(getElement(array, i)));
+        else storage.push_back(toInt(getElement(array, i)));
+      }
+      data = storage.data();
+    }
+    Datatype type = std::is_same_v<T, double> ? Datatype::Double : Datatype::Int;
+    if(name == "sum") return Value{type, kernels::sum(data, array.size())};
+    if(name == "min") return Value{type, kernels::min(data, array.size())};
+    return Value{type, kernels::max(data, array.size())};
+  };
+  if(hasDouble) return run.template operator()<double>();
+  return run.template operator()<int64_t>();
+}
+
+Value Interpreter::callExtreme(const Call& expr){
+  bool maximum = expr.name == "max";
+  if(expr.arguments.size() > 1){
+    auto best = eval(*expr.arguments[0]);
+    for(size_t i = 1; i < expr.arguments.size(); i++){
+      auto value = eval(*expr.arguments[i]);
+      if(maximum ? lessThan(best, value) : lessThan(value, best)) best = std::move(value);
+    }
+    return best;
+  }
+  Value temporary;
+  auto& value = borrow(*expr.arguments[0], temporary);
+  if(value.type == Datatype::String){
+    auto& str = *std::get<Cow<String>> (value.data);
+    if(str.empty()) throw std::runtime_error("The string is empty");
+    return {Datatype::Char, maximum ? *std::max_element(str.begin(), str.end()) : *std::min_element(str.begin(), str.end())};
+  }
+  if(value.type == Datatype::Array){
+    auto& array = *std::get<Cow<Array>> (value.data);
+    auto values = std::get_if<ValueArray> (&array.items);
+    if(values && !values->empty() && values->front().type == Datatype::String){
+      checkOrdered(expr.name, *values);
+      auto less = [&](const Value& left, const Value& right){ return lessThan(left, right); };
+      return maximum ? *std::max_element(values->begin(), values->end(), less) : *std::min_element(values->begin(), values->end(), less);
+    }
+  }
+  return reduce(expr.name, value);
+}
+
+Value Interpreter::callSort(const Call& expr){
+  auto value = eval(*expr.arguments[0]);
+  if(value.type == Datatype::String){
+    auto& str = std::get<Cow<String>> (value.data).mutate();
+    parallelSort(str.data(), str.size(), std::less<char> ());
+    return value;
+  }
+  if(value.type != Datatype::Array) throw std::runtime_error("Function \"sort\" expects an array or a string");
+  auto& array = asArray(value);
+  std::visit([&](auto& buffer){
+    using T = typename std::decay_t<decltype(buffer)>::value_type;
+    if constexpr (std::is_same_v<T, Value>){
+      checkOrdered(expr.name, buffer);
+      parallelSort(buffer.data(), buffer.size(), [&](const Value& left, const Value& right){ return lessThan(left, right); });
+    }
+    else if constexpr (std::is_same_v<T, double>) parallelSort(buffer.data(), buffer.size(), lessDouble);
+    else parallelSort(buffer.data(), buffer.size(), std::less<T> ());
+  }, array.items);
+  return value;
+}
+
+Value Interpreter::callBinarySearch(const Call& expr){
+  Value arrayTemporary, keyTemporary;
+  auto& base = borrow(*expr.arguments[0], arrayTemporary);
+  if(base.type != Datatype::Array) throw std::runtime_error("Function \"binary_search\" expects an array");
+  auto& array = *std::get<Cow<Array>> (base.data);
+  auto& key = borrow(*expr.arguments[1], keyTemporary);
+  if(array.boxed()){
+    auto& values = std::get<ValueArray> (array.items);
+    auto less = [&](const Value& left, const Value& right){ return lessThan(left, right); };
+    auto found = std::lower_bound(values.begin(), values.end(), key, less);
+    if(found == values.end() || lessThan(key, *found)) return {Datatype::Int, int64_t(-1)};
+    return {Datatype::Int, static_cast<int64_t> (found - values.begin())};
+  }
+  if(!isNumeric(key)) throw std::runtime_error("Only numbers or only strings can be compared");
+  return std::visit([&](const auto& buffer) -> Value {
+    using T = typename std::decay_t<decltype(buffer)>::value_type;
+    auto search = [&](auto target, auto convert){
+      auto found = std::lower_bound(buffer.begin(), buffer.end(), target, [&](T element, auto target){ return convert(element) < target; });
+      if(found == buffer.end() || target < convert(*found)) return Value{Datatype::Int, int64_t(-1)};
+      return Value{Datatype::Int, static_cast<int64_t> (found - buffer.begin())};
+    };
+    if constexpr (std::is_same_v<T, Value>) return Value{};
+    else if(std::is_same_v<T, double> || key.type == Datatype::Double){
+      return search(toDouble(key), [&](T element){
+        if constexpr (std::is_same_v<T, char>) return array.type == Datatype::Char ? static_cast<double> (static_cast<unsigned char> (element)) : static_cast<double> (element);
+        else return static_cast<double> (element);
+      });
+    }
+    else return search(toInt(key), [](T element){ return static_cast<int64_t> (element); });
+  }, array.items);
+}
+
+Value Interpreter::callReverse(const Call& expr){
+  auto value = eval(*expr.arguments[0]);
+  if(value.type == Datatype::String){
+    auto& str = std::get<Cow<String>> (value.data).mutate();
+    std::reverse(str.begin(), str.end());
+    return value;
+  }
+  if(value.type != Datatype::Array) throw std::runtime_error("Function \"reverse\" expects an array or a string");
+  std::visit([](auto& buffer){ std::reverse(buffer.begin(), buffer.end()); }, asArray(value).items);
+  return value;
+}
+
+Value Interpreter::callSplit(const Call& expr){
+  Value textTemporary, separatorTemporary;
+  auto& text = borrow(*expr.arguments[0], textTemporary);
+  if(text.type != Datatype::String) throw std::runtime_error("Function \"split\" expects a string");
+  auto& str = *std::get<Cow<String>> (text.data);
+  ValueArray parts;
+  if(expr.arguments.size() == 1){
+    for(size_t i = 0; i < str.size();){
+      if(std::isspace(static_cast<unsigned char> (str[i]))){
+        i++;
+        continue;
+      }
+      size_t start = i;
+      while(i < str.size() && !std::isspace(static_cast<unsigned char> (str[i]))) i++;
+      parts.push_back({Datatype::String, str.substr(start, i - start)});
+    }
+  }
+  else{
+    auto& separatorValue = borrow(*expr.arguments[1], separatorTemporary);
+    if(separatorValue.type != Datatype::String && separatorValue.type != Datatype::Char) throw std::runtime_error("The separator must be a string or a char");
+    String separator;
+    appendString(separator, separatorValue);
+    if(separator.empty()) throw std::runtime_error("The separator must not be empty");
+    size_t start = 0;
+    for(auto found = str.find(separator); found != String::npos; found = str.find(separator, start)){
+      parts.push_back({Datatype::String, str.substr(start, found - start)});
+      start = found + separator.size();
+    }
+    parts.push_back({Datatype::String, str.substr(start)});
+  }
+  Array array;
+  array.items = std::move(parts);
+  return {Datatype::Array, std::move(array)};
+}
+
+Value Interpreter::callJoin(const Call& expr){
+  Value arrayTemporary, separatorTemporary;
+  auto& base = borrow(*expr.arguments[0], arrayTemporary);
+  if(base.type != Datatype::Array) throw std::runtime_error("Function \"join\" expects an array");
+  auto& array = *std::get<Cow<Array>> (base.data);
+  String separator;
+  if(expr.arguments.size() == 2){
+    auto& separatorValue = borrow(*expr.arguments[1], separatorTemporary);
+    if(separatorValue.type != Datatype::String && separatorValue.type != Datatype::Char) throw std::runtime_error("The separator must be a string or a char");
+    appendString(separator, separatorValue);
+  }
+  String result;
+  for(size_t i = 0; i < array.size(); i++){
+    if(i != 0) result.append(separator);
+    if(auto values = std::get_if<ValueArray> (&array.items)) appendString(result, (*values)[i]);
+    else appendString(result, getElement(array, i));
+  }
+  return {Datatype::String, std::move(result)};
+}
+
+std::string Interpreter::fileName(const Call& expr){
+  if(parent) throw std::runtime_error("Files cannot be used inside the parallel for");
+  Value temporary;
+  auto& name = borrow(*expr.arguments[0], temporary);
+  if(name.type != Datatype::String) throw std::runtime_error("The file name must be a string");
+  auto& str = *std::get<Cow<String>> (name.data);
+  return std::string(str.begin(), str.end());
+}
+
+void Interpreter::closeOutput(){
+  if(!outputFile) return;
+  out = console;
+  auto file = std::move(outputFile);
+  file->close();
+}
+
+Value Interpreter::callOpenInput(const Call& expr){
+  inputFile = std::make_unique<MappedFile> (fileName(expr));
+  return {Datatype::Bool, true};
+}
+
+Value Interpreter::callOpenOutput(const Call& expr){
+  auto file = std::make_unique<FileWriter> (fileName(expr));
+  closeOutput();
+  console = out;
+  outputFile = std::move(file);
+  out = outputFile.get();
+  return {Datatype::Bool, true};
+}
+
+Value Interpreter::callCloseInput(const Call&){
+  inputFile.reset();
+  return {Datatype::Bool, true};
+}
+
+Value Interpreter::callCloseOutput(const Call&){
+  closeOutput();
+  return {Datatype::Bool, true};
+}
+
+Value Interpreter::callReadline(const Call&){
+  if(parent) throw std::runtime_error("Input is not permitted inside the parallel for");
+  if(inputFile){
+    auto line = inputFile->line();
+    return {Datatype::String, String(line.begin(), line.end())};
+  }
+  if(channel) throw std::runtime_error("Lines cannot be read from this input");
+  std::string line;
+  std::getline(*in, line);
+  if(!line.empty() && line.back() == '\r') line.pop_back();
+  return {Datatype::String, String(line.begin(), line.end())};
+}
+
+Value Interpreter::callEof(const Call&){
+  if(parent) throw std::runtime_error("Input is not permitted inside the parallel for");
+  if(inputFile) return {Datatype::Bool, inputFile->atEnd()};
+  if(channel) throw std::runtime_error("Lines cannot be read from this input");
+  return {Datatype::Bool, in->peek() == std::char_traits<char>::eof()};
+}
+
+Value Interpreter::callReadFile(const Call& expr){
+  MappedFile file(fileName(expr));
+  auto contents = file.contents();
+  return {Datatype::String, String(contents.begin(), contents.end())};
+}
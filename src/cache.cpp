@@ -0,0 +1,595 @@
+#include "cache.h"
+#include "bigint.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef DOUBLEC_VERSION
+#define DOUBLEC_VERSION "unknown"
+#endif
+
+static constexpr char cacheMagic[8] = {'D', 'C', 'C', 'A', 'C', 'H', 'E', '1'};
+
+enum class NodeTag : uint8_t {
+  None,
+  Output,
+  Input,
+  Definition,
+  ElementDefinition,
+  If,
+  While,
+  For,
+  Value,
+  Variable,
+  Binary,
+  Cast,
+  ArrayLiteral,
+  Index,
+  Call,
+  MapLiteral,
+  CallStatement,
+  Function,
+  Return
+};
+
+namespace{
+  struct Writer{
+    std::string bytes;
+    template <typename T>
+    void put(T value){
+      bytes.append(reinterpret_cast <const char*> (&value), sizeof(value));
+    }
+    void tag(NodeTag tag){
+      put(static_cast <uint8_t> (tag));
+    }
+    void text(std::string_view str){
+      put(static_cast <uint32_t> (str.size()));
+      bytes.append(str);
+    }
+    void location(const Location& location){
+      put(static_cast <uint32_t> (location.line));
+      put(static_cast <uint32_t> (location.column));
+    }
+    void value(const Value& value){
+      put(static_cast <uint8_t> (value.type));
+      switch(value.type){
+        case Datatype::Int:
+          if(auto big = std::get_if <Cow <BigInt>> (&value.data)){
+            put(uint8_t(1));
+            text((*big)->toString());
+          }
+          else{
+            put(uint8_t(0));
+            put(std::get <int64_t> (value.data));
+          }
+          break;
+        case Datatype::Double:
+          put(std::get <double> (value.data));
+          break;
+        case Datatype::Char:
+          put(std::get <char> (value.data));
+          break;
+        case Datatype::Bool:
+          put(static_cast <uint8_t> (std::get <bool> (value.data)));
+          break;
+        case Datatype::String:
+          text(*std::get <Cow <String>> (value.data));
+          break;
+        default:
+          throw std::runtime_error("Such value cannot be cached");
+      }
+    }
+    void program(const Program& program){
+      put(static_cast <uint32_t> (program.statements.size()));
+      for(const auto& stmt : program.statements) statement(*stmt);
+    }
+    void expressions(const std::vector <std::unique_ptr <Expression>>& list){
+      put(static_cast <uint32_t> (list.size()));
+      for(const auto& expr : list) expression(expr.get());
+    }
+    void definition(const Definition& stmt){
+      location(stmt.location);
+      text(stmt.name);
+      put(static_cast <int32_t> (stmt.slot));
+      expression(stmt.value.get());
+    }
+    void ifStatement(const IfStatement& stmt){
+      location(stmt.location);
+      expression(stmt.expr.get());
+      program(*stmt.Instructions);
+      put(static_cast <uint8_t> (stmt.elseStatement != nullptr));
+      if(stmt.elseStatement) ifStatement(*stmt.elseStatement);
+    }
+    void statement(const Statement& stmt){
+      if(auto a = dynamic_cast <const Output*> (&stmt)){
+        tag(NodeTag::Output);
+        location(a->location);
+        expression(a->output.get());
+      }
+      else if(auto a = dynamic_cast <const Input*> (&stmt)){
+        tag(NodeTag::Input);
+        location(a->location);
+        expression(a->input.get());
+      }
+      else if(auto a = dynamic_cast <const Definition*> (&stmt)){
+        tag(NodeTag::Definition);
+        definition(*a);
+      }
+      else if(auto a = dynamic_cast <const ElementDefinition*> (&stmt)){
+        tag(NodeTag::ElementDefinition);
+        location(a->location);
+        text(a->name);
+        put(static_cast <int32_t> (a->slot));
+        expressions(a->index);
+        expression(a->value.get());
+      }
+      else if(auto a = dynamic_cast <const IfStatement*> (&stmt)){
+        tag(NodeTag::If);
+        ifStatement(*a);
+      }
+      else if(auto a = dynamic_cast <const While*> (&stmt)){
+        tag(NodeTag::While);
+        location(a->location);
+        expression(a->expr.get());
+        program(*a->Instructions);
+      }
+      else if(auto a = dynamic_cast <const For*> (&stmt)){
+        tag(NodeTag::For);
+        location(a->location);
+        put(static_cast <uint8_t> (a->op));
+        put(static_cast <uint8_t> (a->parallel));
+        definition(*a->Initialvalue);
+        expression(a->Finalvalue.get());
+        put(static_cast <uint8_t> (a->step != nullptr));
+        if(a->step) definition(*a->step);
+        program(*a->Instructions);
+      }
+      else if(auto a = dynamic_cast <const CallStatement*> (&stmt)){
+        tag(NodeTag::CallStatement);
+        expression(a->call.get());
+      }
+      else if(auto a = dynamic_cast <const Function*> (&stmt)){
+        tag(NodeTag::Function);
+        location(a->location);
+        text(a->name);
+        put(static_cast <uint8_t> (a->pure));
+        put(static_cast <uint32_t> (a->parameters.size()));
+        for(const auto& parameter : a->parameters) text(parameter);
+        put(static_cast <uint32_t> (a->slots));
+        program(*a->body);
+      }
+      else if(auto a = dynamic_cast <const Return*> (&stmt)){
+        tag(NodeTag::Return);
+        location(a->location);
+        expression(a->value.get());
+      }
+      else throw std::runtime_error("Such statement cannot be cached");
+    }
+    void expression(const Expression* expr){
+      if(!expr) tag(NodeTag::None);
+      else if(auto a = dynamic_cast <const exprValue*> (expr)){
+        tag(NodeTag::Value);
+        location(a->location);
+        value(a->value);
+      }
+      else if(auto a = dynamic_cast <const Variable*> (expr)){
+        tag(NodeTag::Variable);
+        location(a->location);
+        text(a->name);
+        put(static_cast <int32_t> (a->slot));
+      }
+      else if(auto a = dynamic_cast <const Binary*> (expr)){
+        tag(NodeTag::Binary);
+        location(a->location);
+        put(static_cast <uint8_t> (a->op));
+        expression(a->left.get());
+        expression(a->right.get());
+      }
+      else if(auto a = dynamic_cast <const Cast*> (expr)){
+        tag(NodeTag::Cast);
+        location(a->location);
+        put(static_cast <uint8_t> (a->castTo));
+        expression(a->expr.get());
+      }
+      else if(auto a = dynamic_cast <const ArrayLiteral*> (expr)){
+        tag(NodeTag::ArrayLiteral);
+        location(a->location);
+        expressions(a->elements);
+      }
+      else if(auto a = dynamic_cast <const MapLiteral*> (expr)){
+        tag(NodeTag::MapLiteral);
+        location(a->location);
+        expressions(a->keys);
+        expressions(a->values);
+      }
+      else if(auto a = dynamic_cast <const Index*> (expr)){
+        tag(NodeTag::Index);
+        location(a->location);
+        expression(a->base.get());
+        expression(a->index.get());
+      }
+      else if(auto a = dynamic_cast <const Call*> (expr)){
+        tag(NodeTag::Call);
+        location(a->location);
+        text(a->name);
+        expressions(a->arguments);
+      }
+      else throw std::runtime_error("Such expression cannot be cached");
+    }
+  };
+
+  struct Reader{
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    int32_t slotLimit = 0;
+    [[noreturn]] static void corrupted(){
+      throw std::runtime_error("The cached program is corrupted");
+    }
+    template <typename T>
+    T get(){
+      if(size - pos < sizeof(T)) corrupted();
+      T value;
+      std::memcpy(&value, data + pos, sizeof(T));
+      pos += sizeof(T);
+      return value;
+    }
+    NodeTag tag(){
+      auto tag = get <uint8_t> ();
+      if(tag > static_cast <uint8_t> (NodeTag::Return)) corrupted();
+      return static_cast <NodeTag> (tag);
+    }
+    std::string_view text(){
+      auto length = get <uint32_t> ();
+      if(size - pos < length) corrupted();
+      std::string_view str(data + pos, length);
+      pos += length;
+      return str;
+    }
+    Location location(){
+      Location location;
+      location.line = get <uint32_t> ();
+      location.column = get <uint32_t> ();
+      return location;
+    }
+    template <typename T>
+    T enumeration(T last){
+      auto value = get <uint8_t> ();
+      if(value > static_cast <uint8_t> (last)) corrupted();
+      return static_cast <T> (value);
+    }
+    Value value(){
+      Value value;
+      value.type = enumeration(Datatype::Invalid);
+      switch(value.type){
+        case Datatype::Int:
+          if(get <uint8_t> () != 0){
+            try{
+              value.data = Cow <BigInt> (BigInt::parse(text()));
+            }
+            catch(const std::invalid_argument&){
+              corrupted();
+            }
+          }
+          else value.data = get <int64_t> ();
+          break;
+        case Datatype::Double:
+          value.data = get <double> ();
+          break;
+        case Datatype::Char:
+          value.data = get <char> ();
+          break;
+        case Datatype::Bool:
+          value.data = get <uint8_t> () != 0;
+          break;
+        case Datatype::String:{
+          auto str = text();
+          value.data = String(str.begin(), str.end());
+          break;
+        }
+        default:
+          corrupted();
+      }
+      return value;
+    }
+    void program(Program& program){
+      auto count = get <uint32_t> ();
+      for(uint32_t i = 0; i < count; i++) program.statements.push_back(statement());
+    }
+    void expressions(std::vector <std::unique_ptr <Expression>>& list){
+      auto count = get <uint32_t> ();
+      for(uint32_t i = 0; i < count; i++) list.push_back(required());
+    }
+    int slot(){
+      auto value = get <int32_t> ();
+      if(value < -1 || value >= slotLimit) corrupted();
+      return value;
+    }
+    void definition(Definition& stmt){
+      stmt.location = location();
+      stmt.name = text();
+      stmt.slot = slot();
+      stmt.value = expression();
+    }
+    void ifStatement(IfStatement& stmt){
+      stmt.location = location();
+      stmt.expr = expression();
+      program(*stmt.Instructions);
+      if(get <uint8_t> ()){
+        stmt.elseStatement = std::make_unique <IfStatement> ();
+        ifStatement(*stmt.elseStatement);
+      }
+    }
+    std::unique_ptr <Statement> statement(){
+      switch(tag()){
+        case NodeTag::Output:{
+          auto stmt = std::make_unique <Output> ();
+          stmt->location = location();
+          stmt->output = required();
+          return stmt;
+        }
+        case NodeTag::Input:{
+          auto stmt = std::make_unique <Input> ();
+          stmt->location = location();
+          stmt->input = required();
+          return stmt;
+        }
+        case NodeTag::Definition:{
+          auto stmt = std::make_unique <Definition> ();
+          definition(*stmt);
+          return stmt;
+        }
+        case NodeTag::ElementDefinition:{
+          auto stmt = std::make_unique <ElementDefinition> ();
+          stmt->location = location();
+          stmt->name = text();
+          stmt->slot = slot();
+          expressions(stmt->index);
+          stmt->value = required();
+          return stmt;
+        }
+        case NodeTag::If:{
+          auto stmt = std::make_unique <IfStatement> ();
+          ifStatement(*stmt);
+          return stmt;
+        }
+        case NodeTag::While:{
+          auto stmt = std::make_unique <While> ();
+          stmt->location = location();
+          stmt->expr = required();
+          program(*stmt->Instructions);
+          return stmt;
+        }
+        case NodeTag::For:{
+          auto stmt = std::make_unique <For> ();
+          stmt->location = location();
+          stmt->op = enumeration(Operator::Invalid);
+          stmt->parallel = get <uint8_t> () != 0;
+          definition(*stmt->Initialvalue);
+          stmt->Finalvalue = required();
+          if(get <uint8_t> ()){
+            stmt->step = std::make_unique <Definition> ();
+            definition(*stmt->step);
+          }
+          stmt->Instructions = std::make_unique <Program> ();
+          program(*stmt->Instructions);
+          return stmt;
+        }
+        case NodeTag::CallStatement:{
+          auto stmt = std::make_unique <CallStatement> ();
+          auto expr = required();
+          auto call = dynamic_cast <Call*> (expr.get());
+          if(!call) corrupted();
+          stmt->call.reset(call);
+          expr.release();
+          stmt->location = call->location;
+          return stmt;
+        }
+        case NodeTag::Function:{
+          if(slotLimit != 0) corrupted();
+          auto stmt = std::make_unique <Function> ();
+          stmt->location = location();
+          stmt->name = text();
+          stmt->pure = get <uint8_t> () != 0;
+          auto count = get <uint32_t> ();
+          for(uint32_t i = 0; i < count; i++) stmt->parameters.emplace_back(text());
+          stmt->slots = get <uint32_t> ();
+          if(stmt->slots < count || stmt->slots > INT32_MAX) corrupted();
+          stmt->body = std::make_unique <Program> ();
+          slotLimit = static_cast <int32_t> (stmt->slots);
+          program(*stmt->body);
+          slotLimit = 0;
+          return stmt;
+        }
+        case NodeTag::Return:{
+          auto stmt = std::make_unique <Return> ();
+          stmt->location = location();
+          stmt->value = expression();
+          return stmt;
+        }
+        default:
+          corrupted();
+      }
+    }
+    std::unique_ptr <Expression> required(){
+      auto expr = expression();
+      if(!expr) corrupted();
+      return expr;
+    }
+    std::unique_ptr <Expression> expression(){
+      switch(tag()){
+        case NodeTag::None:
+          return nullptr;
+        case NodeTag::Value:{
+          auto expr = std::make_unique <exprValue> ();
+          expr->location = location();
+          expr->value = value();
+          return expr;
+        }
+        case NodeTag::Variable:{
+          auto expr = std::make_unique <Variable> ();
+          expr->location = location();
+          expr->name = text();
+          expr->slot = slot();
+          return expr;
+        }
+        case NodeTag::Binary:{
+          auto expr = std::make_unique <Binary> ();
+          expr->location = location();
+          expr->op = enumeration(Operator::Invalid);
+          expr->left = required();
+          expr->right = required();
+          return expr;
+        }
+        case NodeTag::Cast:{
+          auto expr = std::make_unique <Cast> ();
+          expr->location = location();
+          expr->castTo = enumeration(Datatype::Invalid);
+          expr->expr = required();
+          return expr;
+        }
+        case NodeTag::ArrayLiteral:{
+          auto expr = std::make_unique <ArrayLiteral> ();
+          expr->location = location();
+          expressions(expr->elements);
+          return expr;
+        }
+        case NodeTag::MapLiteral:{
+          auto expr = std::make_unique <MapLiteral> ();
+          expr->location = location();
+          expressions(expr->keys);
+          expressions(expr->values);
+          if(expr->keys.size() != expr->values.size()) corrupted();
+          return expr;
+        }
+        case NodeTag::Index:{
+          auto expr = std::make_unique <Index> ();
+          expr->location = location();
+          expr->base = required();
+          expr->index = required();
+          return expr;
+        }
+        case NodeTag::Call:{
+          auto expr = std::make_unique <Call> ();
+          expr->location = location();
+          expr->name = text();
+          expressions(expr->arguments);
+          return expr;
+        }
+        default:
+          corrupted();
+      }
+    }
+  };
+}
+
+static uint64_t fnv(std::string_view bytes, uint64_t hash = 14695981039346656037ull){
+  for(unsigned char c : bytes){
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t sourceHash(const std::string& source, uint32_t format){
+  auto hash = fnv(DOUBLEC_VERSION);
+  hash = fnv(std::string_view(reinterpret_cast <const char*> (&format), sizeof(format)), hash);
+  return fnv(source, hash);
+}
+
+std::string serialize(const Program& program){
+  Writer writer;
+  writer.program(program);
+  return std::move(writer.bytes);
+}
+
+void deserialize(const char* data, size_t size, Program& program){
+  Reader reader{data, size};
+  reader.program(program);
+  if(reader.pos != size) Reader::corrupted();
+}
+
+ProgramCache::ProgramCache(std::string directory, uint32_t format) : directory(std::move(directory)), format(format) {}
+
+std::string ProgramCache::defaultDirectory(){
+  if(auto xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::string(xdg) + "/doublec";
+  if(auto home = std::getenv("HOME"); home && *home) return std::string(home) + "/.cache/doublec";
+  return "";
+}
+
+std::string ProgramCache::path(uint64_t key) const{
+  char name[24];
+  std::snprintf(name, sizeof(name), "%016llx.dcc", static_cast <unsigned long long> (key));
+  return directory + "/" + name;
+}
+
+bool ProgramCache::load(const std::string& source, Program& program) const{
+  auto key = sourceHash(source, format);
+  int file = open(path(key).c_str(), O_RDONLY);
+  if(file < 0) return false;
+  struct stat info;
+  size_t header = sizeof(cacheMagic) + 3 * sizeof(uint64_t);
+  if(fstat(file, &info) != 0 || static_cast <size_t> (info.st_size) < header){
+    close(file);
+    return false;
+  }
+  size_t size = info.st_size;
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if(mapping == MAP_FAILED) return false;
+  auto data = static_cast <const char*> (mapping);
+  uint64_t stored[3];
+  std::memcpy(stored, data + sizeof(cacheMagic), sizeof(stored));
+  bool loaded = false;
+  if(std::memcmp(data, cacheMagic, sizeof(cacheMagic)) == 0 && stored[0] == key && stored[1] == source.size() && stored[2] == fnv(std::string_view(data + header, size - header))){
+    try{
+      deserialize(data + header, size - header, program);
+      loaded = true;
+    }
+    catch(const std::runtime_error&){
+      program.statements.clear();
+    }
+  }
+  munmap(mapping, size);
+  return loaded;
+}
+
+void ProgramCache::store(const std::string& source, const Program& program) const{
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if(error) return;
+  auto key = sourceHash(source, format);
+  auto target = path(key);
+  auto temporary = target + "." + std::to_string(getpid()) + "." + std::to_string(std::hash <std::thread::id> ()(std::this_thread::get_id())) + ".tmp";
+  {
+    std::string bytes;
+    try{
+      bytes = serialize(program);
+    }
+    catch(const std::runtime_error&){
+      return;
+    }
+    std::ofstream out(temporary, std::ios::binary);
+    if(!out.is_open()) return;
+    uint64_t header[3] = {key, source.size(), fnv(bytes)};
+    out.write(cacheMagic, sizeof(cacheMagic));
+    out.write(reinterpret_cast <const char*> (header), sizeof(header));
+    out.write(bytes.data(), bytes.size());
+    if(!out) {
+      out.close();
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temporary, target, error);
+  if(error) std::filesystem::remove(temporary, error);
+}
@@ -0,0 +1,250 @@
+#include "doublec.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "cache.h"
+#include "optimizer.h"
+#include "pipeline.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace doublec{
+  static constexpr size_t recordBuffer = 1 << 20;
+  static constexpr size_t lexerBatch = 256;
+  static constexpr size_t queuedBatches = 16;
+  static constexpr size_t queuedStatements = 64;
+  static constexpr size_t statementBatch = 1024;
+
+  CompiledProgram::CompiledProgram(std::unique_ptr <Program> root) : root(std::move(root)) {}
+
+  CompiledProgram::~CompiledProgram() = default;
+
+  const Program& CompiledProgram::program() const{
+    return *root;
+  }
+
+  std::shared_ptr <const CompiledProgram> compile(const std::string& source, const ProgramCache* cache, Parsing parsing){
+    auto program = std::make_unique <Program> ();
+    if(parsing != Parsing::Eager){
+      Lexer lexer;
+      lexer.load(source);
+      Parser parser(std::make_shared <std::vector <std::vector <Token>>> (lexer.Tokenize()), true);
+      parser.Parse(*program);
+      if(parsing == Parsing::Lazy) parser.Validate();
+    }
+    else if(!cache || !cache->load(source, *program)){
+      Lexer lexer;
+      lexer.load(source);
+      auto tokens = lexer.Tokenize();
+      Parser parser(tokens);
+      parser.Parse(*program);
+      if(cache) cache->store(source, *program);
+    }
+    optimize(*program);
+    releaseDeadVariables(*program);
+    return std::make_shared <const CompiledProgram> (std::move(program));
+  }
+
+  std::string readSource(const std::string& path){
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open()) throw std::runtime_error("Cannot open/find such file");
+    std::ostringstream source;
+    source << in.rdbuf();
+    return source.str();
+  }
+
+  std::chrono::steady_clock::time_point Limits::deadline() const{
+    if(timeout.count() <= 0) return std::chrono::steady_clock::time_point::max();
+    return std::chrono::steady_clock::now() + std::chrono::duration_cast <std::chrono::steady_clock::duration> (timeout);
+  }
+
+  Context::Context(std::istream& in, std::ostream& out) : in(&in), out(&out) {}
+
+  void Context::setTrace(TraceBuffer* buffer){
+    trace = buffer;
+  }
+
+  void Context::setMemoryTracker(MemoryTracker* tracker){
+    this->tracker = tracker;
+  }
+
+  void Context::setLimits(const Limits& limits){
+    this->limits = limits;
+  }
+
+  void Context::run(const CompiledProgram& program){
+    auto previous = MemoryTracker::active();
+    if(tracker) MemoryTracker::active() = tracker;
+    try{
+      Interpreter interpreter;
+      interpreter.setStreams(*in, *out);
+      interpreter.setTrace(trace);
+      interpreter.setLimits(limits.steps, limits.deadline());
+      interpreter.execute(program.program());
+    }
+    catch(...){
+      MemoryTracker::active() = previous;
+      throw;
+    }
+    MemoryTracker::active() = previous;
+  }
+
+  void Context::runEachLine(const CompiledProgram& program, bool keepState, const CompiledProgram* begin){
+    auto previous = MemoryTracker::active();
+    if(tracker) MemoryTracker::active() = tracker;
+    std::ostringstream batch;
+    auto flush = [&](){
+      *out << batch.str();
+      batch.str("");
+    };
+    try{
+      std::istringstream none;
+      Interpreter interpreter;
+      interpreter.setStreams(none, batch);
+      interpreter.setTrace(trace);
+      interpreter.setLimits(limits.steps, limits.deadline());
+      interpreter.setKeepGlobals(keepState);
+      if(begin) interpreter.execute(begin->program());
+      int64_t number = 0;
+      auto record = [&](std::string_view line){
+        if(!keepState) interpreter.reset();
+        interpreter.bind("line", line);
+        interpreter.bind("nr", {Datatype::Int, ++number});
+        interpreter.start(program.program());
+        interpreter.resume(SIZE_MAX);
+        if(static_cast <size_t> (batch.tellp()) >= recordBuffer) flush();
+      };
+      std::vector <char> buffer(recordBuffer);
+      std::string pending;
+      while(*in){
+        in->read(buffer.data(), buffer.size());
+        std::string_view chunk(buffer.data(), in->gcount());
+        size_t begin = 0;
+        for(size_t end; (end = chunk.find('\n', begin)) != std::string_view::npos; begin = end + 1){
+          if(pending.empty()) record(chunk.substr(begin, end - begin));
+          else{
+            pending.append(chunk.substr(begin, end - begin));
+            record(pending);
+            pending.clear();
+          }
+        }
+        pending.append(chunk.substr(begin));
+      }
+      if(!pending.empty()) record(pending);
+      flush();
+    }
+    catch(...){
+      flush();
+      MemoryTracker::active() = previous;
+      throw;
+    }
+    MemoryTracker::active() = previous;
+  }
+
+  void Context::runPipelined(const std::string& source){
+    auto previous = MemoryTracker::active();
+    if(tracker) MemoryTracker::active() = tracker;
+    auto active = MemoryTracker::active();
+    BoundedQueue <std::vector <std::vector <Token>>> lines(queuedBatches);
+    BoundedQueue <std::vector <std::unique_ptr <Statement>>> statements(queuedStatements);
+    std::thread lexing([&](){
+      std::vector <std::vector <Token>> batch;
+      try{
+        Lexer lexer;
+        lexer.load(source);
+        while(!lexer.done()){
+          for(auto& tokenLine : lexer.Tokenize(1)) batch.push_back(std::move(tokenLine));
+          if(batch.size() < lexerBatch) continue;
+          if(!lines.push(std::move(batch))) return;
+          batch.clear();
+        }
+        lines.push(std::move(batch));
+        lines.finish();
+      }
+      catch(...){
+        lines.push(std::move(batch));
+        lines.finish(std::current_exception());
+      }
+    });
+    std::thread parsing([&](){
+      MemoryTracker::active() = active;
+      // The first statement is handed over alone so it starts at once; later batches double to keep the handoffs rare.
+      std::vector <std::unique_ptr <Statement>> batch;
+      try{
+        std::vector <std::vector <Token>> tokens;
+        Parser parser(tokens, lines);
+        size_t limit = 1;
+        parser.Parse([&](std::unique_ptr <Statement> stmt){
+          optimize(stmt);
+          batch.push_back(std::move(stmt));
+          if(batch.size() < limit) return;
+          if(!statements.push(std::move(batch))) throw std::runtime_error("Stopped");
+          batch.clear();
+          limit = std::min(limit * 2, statementBatch);
+        });
+        statements.push(std::move(batch));
+        statements.finish();
+      }
+      catch(...){
+        statements.push(std::move(batch));
+        statements.finish(std::current_exception());
+      }
+      lines.close();
+    });
+    auto stop = [&](){
+      statements.close();
+      lines.close();
+      parsing.join();
+      lexing.join();
+      MemoryTracker::active() = previous;
+    };
+    try{
+      {
+        Program program;
+        Interpreter interpreter;
+        interpreter.setStreams(*in, *out);
+        interpreter.setTrace(trace);
+        interpreter.setLimits(limits.steps, limits.deadline());
+        std::vector <std::vector <std::unique_ptr <Statement>>> parsed;
+        while(statements.pop(parsed)){
+          size_t next = program.statements.size();
+          for(auto& batch : parsed){
+            for(auto& stmt : batch) program.statements.push_back(std::move(stmt));
+          }
+          parsed.clear();
+          interpreter.start(program, next);
+          interpreter.resume(SIZE_MAX);
+        }
+      }
+      stop();
+    }
+    catch(...){
+      stop();
+      throw;
+    }
+  }
+
+  int formatError(const std::exception_ptr& error, std::string& message){
+    try{
+      std::rethrow_exception(error);
+    }
+    catch(const std::invalid_argument& err){
+      message = std::string("Syntax error: ") + err.what();
+      return -1;
+    }
+    catch(const interpreter_error& err){
+      message = std::string("Runtime error: ") + err.what() + " at line: " + std::to_string(err.location.line);
+      if(err.location.column != 0) message += "; column: " + std::to_string(err.location.column);
+      return -2;
+    }
+    catch(const std::exception& err){
+      message = std::string("Runtime error: ") + err.what();
+      return -3;
+    }
+  }
+}
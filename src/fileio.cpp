@@ -0,0 +1,99 @@
+#include "fileio.h"
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr size_t writerBuffer = 1 << 20;
+
+MappedFile::MappedFile(const std::string& path){
+  int file = open(path.c_str(), O_RDONLY);
+  if(file < 0) throw std::runtime_error("Cannot open the file " + path);
+  struct stat info;
+  if(fstat(file, &info) != 0 || !S_ISREG(info.st_mode)){
+    ::close(file);
+    throw std::runtime_error("Cannot open the file " + path);
+  }
+  size = info.st_size;
+  if(size != 0){
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if(mapping == MAP_FAILED){
+      ::close(file);
+      throw std::runtime_error("Cannot map the file " + path);
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast <const char*> (mapping);
+  }
+  ::close(file);
+}
+
+MappedFile::~MappedFile(){
+  if(data) munmap(const_cast <char*> (data), size);
+}
+
+std::string_view MappedFile::word(){
+  while(pos < size && std::isspace(static_cast <unsigned char> (data[pos]))) pos++;
+  size_t begin = pos;
+  while(pos < size && !std::isspace(static_cast <unsigned char> (data[pos]))) pos++;
+  return {data + begin, pos - begin};
+}
+
+std::string_view MappedFile::line(){
+  if(pos == size) return {};
+  size_t begin = pos;
+  auto found = static_cast <const char*> (std::memchr(data + pos, '\n', size - pos));
+  size_t end = found ? found - data : size;
+  pos = found ? end + 1 : size;
+  if(end > begin && data[end - 1] == '\r') end--;
+  return {data + begin, end - begin};
+}
+
+FileWriter::FileWriter(const std::string& path) : std::ostream(&buffer), path(path){
+  buffer.file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(buffer.file < 0) throw std::runtime_error("Cannot open the file " + path);
+  buffer.storage.reserve(writerBuffer);
+}
+
+FileWriter::~FileWriter(){
+  if(buffer.file < 0) return;
+  buffer.drain();
+  ::close(buffer.file);
+}
+
+void FileWriter::close(){
+  bool written = buffer.drain();
+  bool closed = ::close(buffer.file) == 0;
+  buffer.file = -1;
+  if(!written || !closed) throw std::runtime_error("Cannot write the file " + path);
+}
+
+bool FileWriter::Sink::drain(){
+  size_t done = 0;
+  while(!failed && done < storage.size()){
+    auto written = ::write(file, storage.data() + done, storage.size() - done);
+    if(written < 0) failed = true;
+    else done += written;
+  }
+  storage.clear();
+  return !failed;
+}
+
+FileWriter::Sink::int_type FileWriter::Sink::overflow(int_type c){
+  if(traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+  storage.push_back(traits_type::to_char_type(c));
+  if(storage.size() >= writerBuffer && !drain()) return traits_type::eof();
+  return c;
+}
+
+std::streamsize FileWriter::Sink::xsputn(const char* text, std::streamsize count){
+  storage.append(text, count);
+  if(storage.size() >= writerBuffer && !drain()) return 0;
+  return count;
+}
+
+int FileWriter::Sink::sync(){
+  return drain() ? 0 : -1;
+}
@@ -0,0 +1,139 @@
+#include "interpreter.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <pthread.h>
+
+static constexpr size_t stackChunk = 4096;
+static constexpr size_t stackMargin = 256 * 1024;
+
+// Lowest address a call may start at on this thread; the margin leaves room for the statements of the deepest call.
+static uintptr_t stackLimit(){
+  thread_local uintptr_t limit = [](){
+    pthread_attr_t attributes;
+    void* address = nullptr;
+    size_t size = 0;
+    if(pthread_getattr_np(pthread_self(), &attributes) == 0){
+      pthread_attr_getstack(&attributes, &address, &size);
+      pthread_attr_destroy(&attributes);
+    }
+    return address ? reinterpret_cast<uintptr_t> (address) + stackMargin : 0;
+  }();
+  return limit;
+}
+
+Value* CallStack::push(size_t count){
+  if(!chunks.empty() && chunks[current].used + count > chunks[current].size && chunks[current].used != 0) current++;
+  if(current == chunks.size()) chunks.emplace_back();
+  auto& chunk = chunks[current];
+  // A call without slots still gets a real block: a non-null `locals` is what marks code as running inside a call.
+  if(chunk.used + count > chunk.size || !chunk.slots){
+    chunk.size = std::max(stackChunk, count);
+    chunk.slots = std::make_unique<Value[]> (chunk.size);
+    std::fill(chunk.slots.get(), chunk.slots.get() + chunk.size, Value{Datatype::Invalid, {}});
+  }
+  auto block = chunk.slots.get() + chunk.used;
+  chunk.used += count;
+  return block;
+}
+
+void CallStack::pop(Value* block, size_t count){
+  std::fill(block, block + count, Value{Datatype::Invalid, {}});
+  chunks[current].used -= count;
+  if(chunks[current].used == 0 && current > 0) current--;
+}
+
+// Serializes the arguments of a pure call into a cache key; arrays and maps are not cached.
+static bool memoKey(const Value* arguments, size_t count, std::string& key){
+  auto append = [&](const auto& value){
+    key.append(reinterpret_cast<const char*> (&value), sizeof(value));
+  };
+  for(size_t i = 0; i < count; i++){
+    auto& argument = arguments[i];
+    key.push_back(static_cast<char> (argument.type));
+    switch(argument.type){
+      case Datatype::Int:
+        if(auto big = std::get_if<Cow<BigInt>> (&argument.data)){
+          auto digits = (*big)->toString();
+          append(digits.size());
+          key.append(digits);
+        }
+        else append(std::get<int64_t> (argument.data));
+        break;
+      case Datatype::Double:
+        append(std::get<double> (argument.data));
+        break;
+      case Datatype::Char:
+        key.push_back(std::get<char> (argument.data));
+        break;
+      case Datatype::Bool:
+        key.push_back(std::get<bool> (argument.data));
+        break;
+      case Datatype::String:{
+        auto& str = *std::get<Cow<String>> (argument.data);
+        append(str.size());
+        key.append(str.data(), str.size());
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+const Function* Interpreter::findFunction(const std::string& name){
+  if(auto found = functions.find(name); found != functions.end()) return found->second;
+  return parent ? parent->findFunction(name) : nullptr;
+}
+
+void Interpreter::functionDefinition(const Function& stmt){
+  auto [found, inserted] = functions.try_emplace(stmt.name, &stmt);
+  if(builtins().count(stmt.name) || (!inserted && found->second != &stmt)){
+    throw interpreter_error("Function \"" + stmt.name + "\" is already defined", stmt.location.line);
+  }
+}
+
+void Interpreter::returnStatement(const Return& stmt){
+  returned = stmt.value ? eval(*stmt.value) : Value{Datatype::Invalid, {}};
+  frames.erase(frames.begin() + callFloor, frames.end());
+}
+
+Value Interpreter::invoke(const Function& function, const Call& expr){
+  if(expr.arguments.size() != function.parameters.size()){
+    throw interpreter_error("Function \"" + expr.name + "\" expects " + std::to_string(function.parameters.size()) + " argument(s)", expr.location.line, expr.location.column);
+  }
+  if(depth == maxCallDepth || reinterpret_cast<uintptr_t> (__builtin_frame_address(0)) < stackLimit()) throw interpreter_error("The recursion is too deep", expr.location.line, expr.location.column);
+  // Restores the caller's state however the call ends, so an error leaves the interpreter fit to run again.
+  struct CallGuard{
+    Interpreter& self;
+    Value* block;
+    size_t slots;
+    Value* savedLocals;
+    size_t savedFloor;
+    size_t savedDepth;
+    ~CallGuard(){
+      if(self.callFloor != savedFloor) self.frames.erase(self.frames.begin() + self.callFloor, self.frames.end());
+      self.locals = savedLocals;
+      self.callFloor = savedFloor;
+      self.depth = savedDepth;
+      self.stack.pop(block, slots);
+    }
+  } guard{*this, stack.push(function.slots), function.slots, locals, callFloor, depth};
+  auto block = guard.block;
+  for(size_t i = 0; i < expr.arguments.size(); i++) block[i] = eval(*expr.arguments[i]);
+  std::string key;
+  bool cached = function.pure && memoKey(block, expr.arguments.size(), key);
+  if(cached){
+    auto& results = memo[&function];
+    if(auto found = results.find(key); found != results.end()) return found->second;
+  }
+  locals = block;
+  callFloor = frames.size();
+  depth++;
+  frames.push_back({function.body.get(), 0, false});
+  run(callFloor);
+  auto result = std::exchange(returned, Value{Datatype::Invalid, {}});
+  if(cached && result.type != Datatype::Invalid) memo[&function].emplace(std::move(key), result);
+  return result;
+}
@@ -1,4 +1,8 @@
 #include "interpreter.h"
+#include "threadpool.h"
+#include "kernels.h"
+#include "scheduler.h"
+#include <algorithm>
 
 interpreter_error::interpreter_error(const std::string& msg, size_t line, size_t column) : std::runtime_error(msg){
   location.line = line;
@@ -8,48 +12,76 @@ interpreter_error::interpreter_error(const std::string& msg, size_t line, size_t
 Value Interpreter::eval(const Expression& expr){
   if(auto a = dynamic_cast<const exprValue*> (&expr)) return a->value;
   else if (auto a = dynamic_cast<const Variable*> (&expr)) {
-    if(auto b = findVar(a->name)) return *b;
+    if(auto b = findVar(a->name, a->slot)) return *b;
     else throw interpreter_error("No such variable seems to be defined", a->location.line, a->location.column);
   }
   else if (auto a = dynamic_cast<const Binary*> (&expr)) {
     try{
-    switch(a->op){
-      case Operator::Add:
-        return evalAdd(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Sub:
-        return evalSub(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Mul:
-        return evalMul(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Div:
-        return evalDiv(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Mod:
-        return evalMod(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Greater:
-        return evalGr(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Less:
-        return evalLs(eval(*(a->left)), eval(*(a->right)));
-      case Operator::Equal:
-        return evalEq(eval(*(a->left)), eval(*(a->right)));
-      case Operator::NotEqual:
-        return evalNq(eval(*(a->left)), eval(*(a->right)));
-      case Operator::GreaterEq:
-        return evalGe(eval(*(a->left)), eval(*(a->right)));
-      case Operator::LessEq:
-        return evalLe(eval(*(a->left)), eval(*(a->right)));
-      default:
-        throw std::runtime_error("Invalid operator");
+      if(a->op == Operator::Add){
+        auto left = eval(*(a->left));
+        Value temporary;
+        auto& right = borrow(*(a->right), temporary);
+        if(left.type == Datatype::String){
+          appendString(std::get<Cow<String>> (left.data).mutate(), right);
+          return left;
+        }
+        return evalBinary(Operator::Add, left, right);
+      }
+      Value leftTemporary, rightTemporary;
+      auto& left = borrow(*(a->left), leftTemporary);
+      return evalBinary(a->op, left, borrow(*(a->right), rightTemporary));
     }
+    catch(const std::runtime_error& err){
+      throw interpreter_error(err.what(), a->location.line, a->location.column);
+    }
+  }
+  else if (auto a = dynamic_cast<const Index*> (&expr)){
+    try{
+      Value temporary;
+      auto& base = borrow(*a->base, temporary);
+      if(base.type == Datatype::Map){
+        Value keyTemporary;
+        return lookup(*std::get<Cow<Map>> (base.data), borrow(*a->index, keyTemporary));
+      }
+      auto& array = asArray(base);
+      return getElement(array, toIndex(array, eval(*a->index)));
+    }
+    catch(const interpreter_error&){
+      throw;
     }
     catch(const std::runtime_error& err){
       throw interpreter_error(err.what(), a->location.line, a->location.column);
     }
   }
+  else if (auto a = dynamic_cast<const ArrayLiteral*> (&expr)){
+    ValueArray values;
+    values.reserve(a->elements.size());
+    for(const auto& element : a->elements) values.push_back(eval(*element));
+    return {Datatype::Array, makeArray(std::move(values))};
+  }
+  else if (auto a = dynamic_cast<const MapLiteral*> (&expr)){
+    Map map;
+    for(size_t i = 0; i < a->keys.size(); i++){
+      auto key = eval(*a->keys[i]);
+      auto value = eval(*a->values[i]);
+      try{
+        map.insert(key) = std::move(value);
+      }
+      catch(const std::runtime_error& err){
+        throw interpreter_error(err.what(), a->keys[i]->location.line, a->keys[i]->location.column);
+      }
+    }
+    return {Datatype::Map, std::move(map)};
+  }
+  else if (auto a = dynamic_cast<const Call*> (&expr)) return call(*a);
   else if (auto a = dynamic_cast<const Cast*> (&expr)){
-    auto b = eval(*a->expr);
-    if(b.type == Datatype::String) return convertString(*a);
+    Value temporary;
+    auto& b = borrow(*a->expr, temporary);
+    if(b.type == Datatype::String) return convertString(*a, b);
     try{
     switch(a->castTo){
       case Datatype::Int:
+        if(isBig(b)) return b;
         return {Datatype::Int, toInt(b)};
       case Datatype::Double:
         return {Datatype::Double, toDouble(b)};
@@ -57,8 +89,10 @@ Value Interpreter::eval(const Expression& expr){
         return {Datatype::Char, toChar(b)};
       case Datatype::Bool:
         return {Datatype::Bool, isTrue(b)};
-      case Datatype::String:
-        return {Datatype::String, toString(b)};
+      case Datatype::String:{
+        auto str = toString(b);
+        return {Datatype::String, String(str.begin(), str.end())};
+      }
       default:
         throw std::runtime_error("Invalid data type to be casted to" );
     }
@@ -67,6 +101,178 @@ Value Interpreter::eval(const Expression& expr){
       throw interpreter_error(err.what(), a->location.line, a->location.column);
     }
   }
+  else if (auto a = dynamic_cast<const Comparison*> (&expr)) return eval(*a->original);
+}
+
+const Value* Interpreter::reference(const Expression& expr){
+  if(auto a = dynamic_cast<const exprValue*> (&expr)) return &a->value;
+  if(auto a = dynamic_cast<const Variable*> (&expr)) return findVar(a->name, a->slot);
+  if(auto a = dynamic_cast<const Index*> (&expr)){
+    auto base = reference(*a->base);
+    if(!base || (base->type != Datatype::Array && base->type != Datatype::Map)) return nullptr;
+    try{
+      if(base->type == Datatype::Map){
+        Value temporary;
+        auto& key = borrow(*a->index, temporary);
+        if(auto found = std::get<Cow<Map>> (base->data)->find(key)) return found;
+        throw std::runtime_error("The key is not in the map");
+      }
+      auto& array = *std::get<Cow<Array>> (base->data);
+      if(!array.boxed()) return nullptr;
+      return &std::get<ValueArray> (array.items)[toIndex(array, eval(*a->index))];
+    }
+    catch(const interpreter_error&){
+      throw;
+    }
+    catch(const std::runtime_error& err){
+      throw interpreter_error(err.what(), a->location.line, a->location.column);
+    }
+  }
+  return nullptr;
+}
+
+const Value& Interpreter::borrow(const Expression& expr, Value& temporary){
+  if(auto a = reference(expr)) return *a;
+  temporary = eval(expr);
+  return temporary;
+}
+
+void Interpreter::callStatement(const CallStatement& stmt){
+  auto& expr = *stmt.call;
+  if(auto function = findFunction(expr.name)){
+    invoke(*function, expr);
+    return;
+  }
+  if(expr.name != "erase"){
+    call(expr);
+    return;
+  }
+  auto target = expr.arguments.size() == 2 ? dynamic_cast<const Variable*> (expr.arguments[0].get()) : nullptr;
+  if(!target) throw interpreter_error("Function \"erase\" expects a map variable and a key", expr.location.line, expr.location.column);
+  auto value = findVar(target->name, target->slot);
+  if(!value) throw interpreter_error("No such variable seems to be defined", target->location.line, target->location.column);
+  if(target->slot < 0 && parent && !findLocal(target->name)) throw interpreter_error("Variables defined outside of the parallel for cannot be changed inside it", expr.location.line, expr.location.column);
+  try{
+    auto key = eval(*expr.arguments[1]);
+    asMap(*value).erase(key);
+  }
+  catch(const interpreter_error&){
+    throw;
+  }
+  catch(const std::runtime_error& err){
+    throw interpreter_error(err.what(), expr.location.line, expr.location.column);
+  }
+}
+
+Map& Interpreter::asMap(Value& value){
+  if(value.type != Datatype::Map) throw std::runtime_error("A map is expected");
+  return std::get<Cow<Map>> (value.data).mutate();
+}
+
+const Map& Interpreter::asMap(const Value& value){
+  if(value.type != Datatype::Map) throw std::runtime_error("A map is expected");
+  return *std::get<Cow<Map>> (value.data);
+}
+
+Value Interpreter::lookup(const Map& map, const Value& key){
+  if(auto found = map.find(key)) return *found;
+  throw std::runtime_error("The key is not in the map");
+}
+
+Array Interpreter::makeArray(ValueArray&& values){
+  Array array;
+  array.type = values.empty() ? Datatype::Invalid : values[0].type;
+  for(const auto& value : values){
+    if(value.type != array.type || isBig(value)) array.type = Datatype::Invalid;
+  }
+  switch(array.type){
+    case Datatype::Int:{
+      Buffer<int64_t> buffer;
+      buffer.reserve(values.size());
+      for(const auto& value : values) buffer.push_back(std::get<int64_t> (value.data));
+      array.items = std::move(buffer);
+      break;
+    }
+    case Datatype::Double:{
+      Buffer<double> buffer;
+      buffer.reserve(values.size());
+      for(const auto& value : values) buffer.push_back(std::get<double> (value.data));
+      array.items = std::move(buffer);
+      break;
+    }
+    case Datatype::Char:
+    case Datatype::Bool:{
+      Buffer<char> buffer;
+      buffer.reserve(values.size());
+      for(const auto& value : values) buffer.push_back(array.type == Datatype::Bool ? std::get<bool> (value.data) : std::get<char> (value.data));
+      array.items = std::move(buffer);
+      break;
+    }
+    default:
+      array.type = Datatype::Invalid;
+      array.items = std::move(values);
+  }
+  return array;
+}
+
+Array& Interpreter::asArray(Value& value){
+  if(value.type != Datatype::Array) throw std::runtime_error("Only arrays and maps can be indexed");
+  return std::get<Cow<Array>> (value.data).mutate();
+}
+
+const Array& Interpreter::asArray(const Value& value){
+  if(value.type != Datatype::Array) throw std::runtime_error("Only arrays and maps can be indexed");
+  return *std::get<Cow<Array>> (value.data);
+}
+
+size_t Interpreter::toIndex(const Array& array, const Value& index){
+  if(index.type != Datatype::Int && index.type != Datatype::Char && index.type != Datatype::Bool) throw std::runtime_error("The array index must be an integer");
+  auto i = toInt(index);
+  if(i < 0 || static_cast<size_t> (i) >= array.size()) throw std::runtime_error("The array index is out of range");
+  return i;
+}
+
+Value Interpreter::getElement(const Array& array, size_t index){
+  switch(array.type){
+    case Datatype::Int:
+      return {Datatype::Int, std::get<Buffer<int64_t>> (array.items)[index]};
+    case Datatype::Double:
+      return {Datatype::Double, std::get<Buffer<double>> (array.items)[index]};
+    case Datatype::Char:
+      return {Datatype::Char, std::get<Buffer<char>> (array.items)[index]};
+    case Datatype::Bool:
+      return {Datatype::Bool, std::get<Buffer<char>> (array.items)[index] != 0};
+    default:
+      return std::get<ValueArray> (array.items)[index];
+  }
+}
+
+void Interpreter::setElement(Array& array, size_t index, Value&& value){
+  if(!array.boxed() && (array.type != value.type || isBig(value))) boxArray(array);
+  switch(array.type){
+    case Datatype::Int:
+      std::get<Buffer<int64_t>> (array.items)[index] = std::get<int64_t> (value.data);
+      break;
+    case Datatype::Double:
+      std::get<Buffer<double>> (array.items)[index] = std::get<double> (value.data);
+      break;
+    case Datatype::Char:
+      std::get<Buffer<char>> (array.items)[index] = std::get<char> (value.data);
+      break;
+    case Datatype::Bool:
+      std::get<Buffer<char>> (array.items)[index] = std::get<bool> (value.data);
+      break;
+    default:
+      std::get<ValueArray> (array.items)[index] = std::move(value);
+  }
+}
+
+void Interpreter::boxArray(Array& array){
+  ValueArray values;
+  values.reserve(array.size());
+  for(size_t i = 0; i < array.size(); i++) values.push_back(getElement(array, i));
+  array.type = Datatype::Invalid;
+  array.items = std::move(values);
 }
 
 bool Interpreter::isNumeric(const Value& value){
@@ -74,24 +280,34 @@ bool Interpreter::isNumeric(const Value& value){
   return false;
 }
 
-Value Interpreter::convertString(const Cast& expr){
+Value Interpreter::convertString(const Cast& expr, const Value& b){
   try{
-    auto b = eval(*expr.expr);
+    auto& a = *std::get<Cow<String>> (b.data);
     switch(expr.castTo){
       case Datatype::Int:
-        return {Datatype::Int, std::stoll(std::get<std::string> (b.data))};
+        try{
+          return {Datatype::Int, std::stoll(std::string(a))};
+        }
+        catch(const std::out_of_range&){
+          return normalize(BigInt::parse(std::string_view(a.data(), a.size())));
+        }
       case Datatype::Double:
-        return {Datatype::Double, std::stod(std::get<std::string> (b.data))};
+        return {Datatype::Double, std::stod(std::string(a))};
       case Datatype::Char:
-        if(auto a = std::get <std::string> (b.data); a.size() == 1) return {Datatype::Char, a[0]};
+        if(a.size() == 1) return {Datatype::Char, a[0]};
         else throw std::runtime_error("err");
       case Datatype::Bool:
-        if(auto a = std::get<std::string> (b.data); a == "true" || a == "false") return {Datatype::Bool, a == "true" ? true:false};
+        if(a == "true" || a == "false") return {Datatype::Bool, a == "true" ? true:false};
         throw std::runtime_error("err");
+      case Datatype::String:
+        return b;
       default:
         throw std::runtime_error("err");
     }
   }
+  catch(const memory_limit_error&){
+    throw;
+  }
   catch(const std::exception&){
     throw interpreter_error("The string cannot be casted to another data type", expr.location.line, expr.location.column);
   }
@@ -100,6 +316,7 @@ Value Interpreter::convertString(const Cast& expr){
 double Interpreter::toDouble(const Value& value){
   switch(value.type){
     case Datatype::Int:
+      if(auto big = std::get_if<Cow<BigInt>> (&value.data)) return (*big)->toDouble();
       return std::get<int64_t> (value.data);
     case Datatype::Double:
       return std::get<double> (value.data);
@@ -115,6 +332,7 @@ double Interpreter::toDouble(const Value& value){
 int64_t Interpreter::toInt(const Value& value){
   switch(value.type){
     case Datatype::Int:
+      if(isBig(value)) throw std::runtime_error("The integer is too big");
       return std::get<int64_t> (value.data);
     case Datatype::Double:
       return static_cast<int64_t> (std::round(std::get<double> (value.data)));
@@ -127,9 +345,24 @@ int64_t Interpreter::toInt(const Value& value){
   }
 }
 
+bool Interpreter::isBig(const Value& value){
+  return std::holds_alternative<Cow<BigInt>> (value.data);
+}
+
+BigInt Interpreter::toBig(const Value& value){
+  if(auto big = std::get_if<Cow<BigInt>> (&value.data)) return **big;
+  return toInt(value);
+}
+
+Value Interpreter::normalize(BigInt value){
+  if(value.fits()) return {Datatype::Int, value.toInt64()};
+  return {Datatype::Int, Cow<BigInt> (std::move(value))};
+}
+
 std::string Interpreter::toString(const Value& value){
   switch(value.type){
     case Datatype::Int:
+      if(auto big = std::get_if<Cow<BigInt>> (&value.data)) return (*big)->toString();
       return std::to_string(std::get<int64_t>(value.data));
     case Datatype::Double:
       return std::to_string(std::get<double>(value.data));
@@ -137,128 +370,358 @@ std::string Interpreter::toString(const Value& value){
       return std::string(1, std::get <char> (value.data));
     case Datatype::Bool:
       return std::get<bool> (value.data) ? "true" : "false";
+    case Datatype::String:{
+      auto& str = *std::get<Cow<String>> (value.data);
+      return std::string(str.begin(), str.end());
+    }
+    case Datatype::Array:
+    case Datatype::Map:{
+      std::ostringstream stream;
+      print(stream, value);
+      return stream.str();
+    }
     default:
       throw std::runtime_error("Such data type cannot be casted to string");
   }
 }
 
+void Interpreter::appendString(String& target, const Value& value){
+  switch(value.type){
+    case Datatype::String:
+      target.append(*std::get<Cow<String>> (value.data));
+      break;
+    case Datatype::Char:
+      target.push_back(std::get<char> (value.data));
+      break;
+    default:{
+      auto str = toString(value);
+      target.append(str.begin(), str.end());
+    }
+  }
+}
+
 char Interpreter::toChar(const Value& value){
   int64_t var = toInt(value);
   if(var < 0 || var > 255) throw std::runtime_error("the value is too big to be casted");
   return static_cast<char>(static_cast<unsigned char>(var));
 }
 
-Value Interpreter::evalAdd(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"+\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Double, toDouble(left) + toDouble(right)};
-  return {Datatype::Int, toInt(left) + toInt(right)};
+Value Interpreter::evalArray(Operator op, const char* symbol, const Value& left, const Value& right){
+  auto invalid = [&](){
+    return std::runtime_error(std::string("Operator \"") + symbol + "\" cannot be used to such value type");
+  };
+  size_t size = 0;
+  bool sized = false;
+  bool hasDouble = op == Operator::Div;
+  for(auto operand : {&left, &right}){
+    if(operand->type == Datatype::Array){
+      auto& array = *std::get<Cow<Array>> (operand->data);
+      if(sized && array.size() != size) throw std::runtime_error("The arrays have different sizes");
+      size = array.size();
+      sized = true;
+      if(array.type == Datatype::Double) hasDouble = true;
+      else if(array.boxed()){
+        for(const auto& value : std::get<ValueArray> (array.items)){
+          if(!isNumeric(value)) throw invalid();
+          if(value.type == Datatype::Double) hasDouble = true;
+        }
+      }
+    }
+    else if(!isNumeric(*operand)) throw invalid();
+    else if(operand->type == Datatype::Double) hasDouble = true;
+  }
+  bool comparison = op != Operator::Add && op != Operator::Sub && op != Operator::Mul && op != Operator::Div;
+  auto run = [&]<typename T>(){
+    Buffer<T> storage[2];
+    T scalars[2];
+    const T* data[2];
+    bool scalar[2];
+    const Value* operands[2] = {&left, &right};
+    for(int k = 0; k < 2; k++){
+      scalar[k] = operands[k]->type != Datatype::Array;
+      if(scalar[k]){
+        if constexpr (std::is_same_v<T, double>) scalars[k] = toDouble(*operands[k]);
+        else scalars[k] = toInt(*operands[k]);
+        data[k] = &scalars[k];
+        continue;
+      }
+      auto& array = *std::get<Cow<Array>> (operands[k]->data);
+      if(auto buffer = std::get_if<Buffer<T>> (&array.items)){
+        data[k] = buffer->data();
+        continue;
+      }
+      storage[k].reserve(array.size());
+      for(size_t i = 0; i < array.size(); i++){
+        if constexpr (std::is_same_v<T, double>) storage[k].push_back(toDouble(getElement(array, i)));
+        else storage[k].push_back(toInt(getElement(array, i)));
+      }
+      data[k] = storage[k].data();
+    }
+    if(op == Operator::Div && std::find(data[1], data[1] + (scalar[1] ? 1 : size), T(0)) != data[1] + (scalar[1] ? 1 : size)){
+      throw std::runtime_error("Division by zero is not permitted");
+    }
+    Array result;
+    if(comparison){
+      Buffer<char> buffer(size);
+      kernels::compare(op, data[0], scalar[0], data[1], scalar[1], buffer.data(), size);
+      result.type = Datatype::Bool;
+      result.items = std::move(buffer);
+    }
+    else{
+      Buffer<T> buffer(size);
+      kernels::arithmetic(op, data[0], scalar[0], data[1], scalar[1], buffer.data(), size);
+      result.type = std::is_same_v<T, double> ? Datatype::Double : Datatype::Int;
+      result.items = std::move(buffer);
+    }
+    return Value{Datatype::Array, std::move(result)};
+  };
+  if(hasDouble) return run.template operator()<double>();
+  return run.template operator()<int64_t>();
 }
 
-Value Interpreter::evalSub(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"-\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Double, toDouble(left) - toDouble(right)};
-  return {Datatype::Int, toInt(left) - toInt(right)};
+bool Interpreter::isTrue(const Value& value){
+  switch (value.type){
+    case Datatype::Int:
+      return isBig(value) || std::get <int64_t> (value.data) != 0;
+    case Datatype::Char:
+      return std::get <char> (value.data) != '\0';
+    case Datatype::String:
+      return !std::get <Cow<String>>(value.data)->empty();
+    case Datatype::Double:
+      return std::get <double> (value.data) != 0;
+    case Datatype::Bool:
+      return std::get <bool> (value.data);
+    case Datatype::Array:
+      return std::get <Cow<Array>>(value.data)->size() != 0;
+    case Datatype::Map:
+      return std::get <Cow<Map>>(value.data)->size() != 0;
+    default:
+      return false;
+  }
 }
 
-Value Interpreter::evalMul(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"*\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Double, toDouble(left) * toDouble(right)};
-  return {Datatype::Int, toInt(left) * toInt(right)};
+Value* Interpreter::findLocal(const std::string& name){
+  for (auto i = variables.rbegin(); i != variables.rend();i++){
+    auto found = i->find(name);
+    if(found != i->end()) return &found -> second;
+  }
+  return nullptr;
 }
 
-Value Interpreter::evalDiv(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"/\" cannot be used to such value type");
-  auto DBLright = toDouble(right);
-  if(DBLright == 0.0) throw std::runtime_error("Division by zero is not permitted");
-  return {Datatype::Double, toDouble(left) / DBLright};
+Value* Interpreter::findVar(const std::string& name){
+  if(auto found = findLocal(name)) return found;
+  if(parent) return parent->findVar(name);
+  return nullptr;
 }
 
-Value Interpreter::evalMod(const Value& left, const Value& right){
-  if(left.type != Datatype::Int || right.type != Datatype::Int) throw std::runtime_error("Operator \"%\" cannot be used to such value type");
-  auto INTright = toInt(right);
-  if(INTright == 0) throw std::runtime_error("Division by zero is not permitted");
-  return {Datatype::Int, toInt(left) % toInt(right)};
+Value* Interpreter::findVar(const std::string& name, int slot){
+  if(slot < 0) return findVar(name);
+  auto& value = locals[slot];
+  return value.type == Datatype::Invalid ? nullptr : &value;
 }
 
-Value Interpreter::evalGr(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \">\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Bool, toDouble(left) > toDouble(right)};
-  return {Datatype::Bool, toInt(left) > toInt(right)};
+Value& Interpreter::declare(const std::string& name, int slot){
+  if(slot < 0) return variables.back()[name];
+  return locals[slot];
 }
 
-Value Interpreter::evalLs(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"<\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Bool, toDouble(left) < toDouble(right)};
-  return {Datatype::Bool, toInt(left) < toInt(right)};
+template <typename T>
+static bool compareAs(Operator op, T left, T right){
+  switch(op){
+    case Operator::Less: return left < right;
+    case Operator::Greater: return left > right;
+    case Operator::LessEq: return left <= right;
+    case Operator::GreaterEq: return left >= right;
+    case Operator::Equal: return left == right;
+    default: return left != right;
+  }
 }
 
-Value Interpreter::evalGe(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \">=\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Bool, toDouble(left) >= toDouble(right)};
-  return {Datatype::Bool, toInt(left) >= toInt(right)};
+bool Interpreter::condition(const Expression& expr){
+  auto a = dynamic_cast<const Comparison*> (&expr);
+  if(!a) return isTrue(eval(expr));
+  auto left = findVar(a->name, a->slot);
+  auto right = a->other ? findVar(a->other->name, a->other->slot) : &a->literal;
+  if(left && right){
+    auto leftInt = std::get_if<int64_t> (&left->data);
+    auto rightInt = std::get_if<int64_t> (&right->data);
+    if(leftInt && rightInt) return compareAs(a->op, *leftInt, *rightInt);
+    auto leftDouble = std::get_if<double> (&left->data);
+    auto rightDouble = std::get_if<double> (&right->data);
+    if((leftInt || leftDouble) && (rightInt || rightDouble)){
+      return compareAs(a->op, leftInt ? static_cast<double> (*leftInt) : *leftDouble, rightInt ? static_cast<double> (*rightInt) : *rightDouble);
+    }
+  }
+  return isTrue(eval(*a->original));
 }
 
-Value Interpreter::evalLe(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"<=\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Bool, toDouble(left) <= toDouble(right)};
-  return {Datatype::Bool, toInt(left) <= toInt(right)};
+// Applies `target op operand` in place when the result has the value and type definition() would give it;
+// returns false and leaves the target untouched otherwise.
+static bool updateInPlace(Value& target, Operator op, const Value& operand){
+  auto value = std::get_if<int64_t> (&target.data);
+  auto integer = std::get_if<int64_t> (&operand.data);
+  if(value && integer){
+    int64_t result;
+    switch(op){
+      case Operator::Add:
+        if(__builtin_add_overflow(*value, *integer, &result)) return false;
+        break;
+      case Operator::Sub:
+        if(__builtin_sub_overflow(*value, *integer, &result)) return false;
+        break;
+      case Operator::Mul:
+        if(__builtin_mul_overflow(*value, *integer, &result)) return false;
+        break;
+      case Operator::Mod:
+        if(*integer == 0 || *integer == -1) return false;
+        result = *value % *integer;
+        break;
+      case Operator::Div:
+        if(*integer == 0) return false;
+        target = {Datatype::Double, static_cast<double> (*value) / static_cast<double> (*integer)};
+        return true;
+      default:
+        return false;
+    }
+    *value = result;
+    return true;
+  }
+  auto number = std::get_if<double> (&target.data);
+  if((!value && !number) || op == Operator::Mod) return false;
+  double left = value ? static_cast<double> (*value) : *number;
+  double right = integer ? static_cast<double> (*integer) : std::get<double> (operand.data);
+  switch(op){
+    case Operator::Add:
+      target = {Datatype::Double, left + right};
+      return true;
+    case Operator::Sub:
+      target = {Datatype::Double, left - right};
+      return true;
+    case Operator::Mul:
+      target = {Datatype::Double, left * right};
+      return true;
+    case Operator::Div:
+      if(right == 0.0) return false;
+      target = {Datatype::Double, left / right};
+      return true;
+    default:
+      return false;
+  }
 }
 
-Value Interpreter::evalEq(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"==\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Bool, toDouble(left) == toDouble(right)};
-  return {Datatype::Bool, toInt(left) == toInt(right)};
+void Interpreter::update(const Update& stmt){
+  Value* target = stmt.slot >= 0 || !parent ? findVar(stmt.name, stmt.slot) : nullptr;
+  if(!target || !updateInPlace(*target, stmt.op, stmt.operand)){
+    definition(*stmt.original);
+    return;
+  }
+  if(trace) trace->record(TraceKind::Definition, stmt.location, *target);
 }
 
-Value Interpreter::evalNq(const Value& left, const Value& right){
-  if(!isNumeric(left) || !isNumeric(right)) throw std::runtime_error("Operator \"!=\" cannot be used to such value type");
-  if(left.type == Datatype::Double || right.type == Datatype::Double) return {Datatype::Bool, toDouble(left) != toDouble(right)};
-  return {Datatype::Bool, toInt(left) != toInt(right)};
+void Interpreter::definition(const Definition& stmt){
+  Value* b = findVar(stmt.name, stmt.slot);
+  if(b && stmt.slot < 0 && parent && !findLocal(stmt.name)) throw interpreter_error("Variables defined outside of the parallel for cannot be changed inside it", stmt.location.line);
+  if(b && b->type == Datatype::String && appendInPlace(stmt, std::get<Cow<String>> (b->data))){
+    if(trace) trace->record(TraceKind::Definition, stmt.location, *b);
+    return;
+  }
+  if(b) *b = eval(*stmt.value);
+  else{
+    auto value = eval(*stmt.value);
+    b = &(declare(stmt.name, stmt.slot) = std::move(value));
+  }
+  if(trace) trace->record(TraceKind::Definition, stmt.location, *b);
 }
 
-bool Interpreter::isTrue(const Value& value){
-  switch (value.type){
-    case Datatype::Int:
-      return std::get <int64_t> (value.data) != 0;
-    case Datatype::Char:
-      return std::get <char> (value.data) != '\0';
-    case Datatype::String:
-      return !std::get <std::string>(value.data).empty();
-    case Datatype::Double:
-      return std::get <double> (value.data) != 0;
-    case Datatype::Bool:
-      return std::get <bool> (value.data);
-    case Datatype::Array:
-      return !std::get <std::vector <Value>>(value.data).empty();
+// Only the running block's own scope is searched: a name found further out belongs to code that may still use it.
+void Interpreter::release(const Release& stmt){
+  if(locals || (keepGlobals && !frames.back().scoped)) return;
+  for(const auto& name : stmt.names){
+    if(std::find(bound.begin(), bound.end(), name) == bound.end()) variables.back().erase(name);
   }
 }
 
-Value* Interpreter::findVar(const std::string& name){
-  for (auto i = variables.rbegin(); i != variables.rend();i++){
-    auto found = i->find(name);
-    if(found != i->end()) return &found -> second;
+bool Interpreter::appendInPlace(const Definition& stmt, Cow<String>& target){
+  std::vector <const Binary*> parts;
+  const Expression* node = stmt.value.get();
+  while(auto a = dynamic_cast<const Binary*> (node)){
+    if(a->op != Operator::Add) break;
+    parts.push_back(a);
+    node = a->left.get();
   }
-  return nullptr;
+  auto variable = dynamic_cast<const Variable*> (node);
+  if(parts.empty() || !variable || variable->name != stmt.name) return false;
+  if(parts.size() == 1){
+    Value temporary;
+    auto& value = borrow(*parts[0]->right, temporary);
+    try{
+      appendString(target.mutate(), value);
+    }
+    catch(const std::runtime_error& err){
+      throw interpreter_error(err.what(), parts[0]->location.line, parts[0]->location.column);
+    }
+    return true;
+  }
+  std::vector <Value> values;
+  values.reserve(parts.size());
+  for(auto part = parts.rbegin(); part != parts.rend(); part++) values.push_back(eval(*(*part)->right));
+  for(size_t i = 0; i < values.size(); i++){
+    try{
+      appendString(target.mutate(), values[i]);
+    }
+    catch(const std::runtime_error& err){
+      throw interpreter_error(err.what(), parts[parts.size() - 1 - i]->location.line, parts[parts.size() - 1 - i]->location.column);
+    }
+  }
+  return true;
 }
 
-void Interpreter::definition(const Definition& stmt){
-  if(auto b = findVar(stmt.name)) *b = eval(*stmt.value);
-  else variables.back()[stmt.name] = eval(*stmt.value);
+void Interpreter::elementDefinition(const ElementDefinition& stmt){
+  auto target = findVar(stmt.name, stmt.slot);
+  if(!target) throw interpreter_error("No such variable seems to be defined", stmt.location.line);
+  if(stmt.slot < 0 && parent && !findLocal(stmt.name)) throw interpreter_error("Variables defined outside of the parallel for cannot be changed inside it", stmt.location.line);
+  try{
+    auto value = eval(*stmt.value);
+    for(size_t i = 0; i + 1 < stmt.index.size(); i++){
+      if(target->type == Datatype::Map){
+        auto& map = asMap(*target);
+        target = map.find(eval(*stmt.index[i]));
+        if(!target) throw std::runtime_error("The key is not in the map");
+        continue;
+      }
+      auto& array = asArray(*target);
+      auto index = toIndex(array, eval(*stmt.index[i]));
+      if(!array.boxed()) throw std::runtime_error("Only arrays can be indexed");
+      target = &std::get<ValueArray> (array.items)[index];
+    }
+    if(target->type == Datatype::Map){
+      auto& map = asMap(*target);
+      auto key = eval(*stmt.index.back());
+      if(trace) trace->record(TraceKind::Definition, stmt.location, value);
+      map.insert(key) = std::move(value);
+      return;
+    }
+    auto& array = asArray(*target);
+    auto index = toIndex(array, eval(*stmt.index.back()));
+    if(trace) trace->record(TraceKind::Definition, stmt.location, value);
+    setElement(array, index, std::move(value));
+  }
+  catch(const interpreter_error&){
+    throw;
+  }
+  catch(const std::runtime_error& err){
+    throw interpreter_error(err.what(), stmt.location.line);
+  }
 }
 
 void Interpreter::input(const Input& stmt){
   if(auto a = dynamic_cast <const Variable*> (stmt.input.get())){
-    std::string str;
-    std::cin >> str;
-    variables.back()[a->name] = {Datatype::String, str};
+    declare(a->name, a->slot) = {Datatype::String, readWord()};
     return;
   }
   else if (auto a = dynamic_cast <const Cast*> (stmt.input.get())){
     if(auto b = dynamic_cast <const Variable*> (a->expr.get())){
-      std::string str;
-      std::cin>>str;
-      variables.back()[b->name] = {Datatype::String, str};
-      variables.back()[b->name] = convertString(*a);
+      declare(b->name, b->slot) = convertString(*a, {Datatype::String, readWord()});
       return;
     }
   }
@@ -266,66 +729,134 @@ void Interpreter::input(const Input& stmt){
 
 }
 
-void Interpreter::output(const Output& stmt){
-  Value value = eval(*stmt.output);
+String Interpreter::readWord(){
+  String word;
+  if(inputFile){
+    auto text = inputFile->word();
+    word.assign(text.begin(), text.end());
+  }
+  else if(channel){
+    if(!channel->ready()) stall();
+    channel->read(word);
+  }
+  else *in >> word;
+  return word;
+}
+
+void Interpreter::print(std::ostream& stream, const Value& value){
   switch(value.type){
     case Datatype::Int:
-      std::cout<<std::get<int64_t>(value.data);
+      if(auto big = std::get_if<Cow<BigInt>> (&value.data)) stream<<(*big)->toString();
+      else stream<<std::get<int64_t>(value.data);
       break;
     case Datatype::Double:
-      std::cout<<std::get<double>(value.data);
+      stream<<std::get<double>(value.data);
       break;
     case Datatype::Char:
-      std::cout<<std::get<char>(value.data);
+      stream<<std::get<char>(value.data);
       break;
     case Datatype::Bool:
-      std::cout<<std::get<bool> (value.data);
+      stream<<std::get<bool> (value.data);
       break;
     case Datatype::String:
-      std::cout<<std::get<std::string>(value.data);
+      stream<<*std::get<Cow<String>>(value.data);
+      break;
+    case Datatype::Array:{
+      auto& array = *std::get<Cow<Array>> (value.data);
+      stream<<'[';
+      for(size_t i = 0; i < array.size(); i++){
+        if(i != 0) stream<<", ";
+        print(stream, getElement(array, i));
+      }
+      stream<<']';
       break;
+    }
+    case Datatype::Map:{
+      bool first = true;
+      stream<<'{';
+      std::get<Cow<Map>> (value.data)->forEach([&](const Value& key, const Value& element){
+        if(!first) stream<<", ";
+        first = false;
+        print(stream, key);
+        stream<<": ";
+        print(stream, element);
+      });
+      stream<<'}';
+      break;
+    }
     default:
-      throw interpreter_error("Such data type cannot be printed", stmt.location.line);
+      throw std::runtime_error("Such data type cannot be printed");
   }
 }
 
-void Interpreter::ifStatement(const IfStatement& stmt){
-  if(isTrue(eval(*stmt.expr))) {
-    variables.push_back({});
-    for(size_t i = 0; i < stmt.Instructions->statements.size(); i++){
-      matchStatement(*stmt.Instructions->statements[i]);
+void Interpreter::output(const Output& stmt){
+  Value temporary;
+  try{
+    print(*out, borrow(*stmt.output, temporary));
+  }
+  catch(const interpreter_error&){
+    throw;
+  }
+  catch(const std::runtime_error& err){
+    throw interpreter_error(err.what(), stmt.location.line);
+  }
+}
+
+void Interpreter::enter(const Program& body, const Statement* loop){
+  if(auto lazy = dynamic_cast<const LazyProgram*> (&body)) lazy->load();
+  bool scoped = locals == nullptr;
+  if(scoped) variables.push_back({});
+  frames.push_back({&body, 0, scoped, loop});
+}
+
+// The condition and the step may call functions, whose frames can move this one, so it is looked up again after them.
+bool Interpreter::repeat(size_t index){
+  auto loop = frames[index].loop;
+  if(auto a = dynamic_cast<const While*> (loop)){
+    if(!condition(*a->expr)) return false;
+  }
+  else if(auto a = dynamic_cast<const For*> (loop)){
+    auto iterator = frames[index].iterator;
+    auto direction = frames[index].direction;
+    forstep(iterator, direction, *a);
+    auto& frame = frames[index];
+    frame.iterator = iterator;
+    if(!forCondition(*a, toInt(*iterator), frame.Final, direction)){
+      if(frame.scoped) variables.pop_back();
+      return false;
     }
-  variables.pop_back();
   }
+  else return false;
+  auto& frame = frames[index];
+  if(frame.scoped) variables.push_back({});
+  frame.next = 0;
+  return true;
+}
+
+void Interpreter::ifStatement(const IfStatement& stmt){
+  if(isTrue(eval(*stmt.expr))) enter(*stmt.Instructions);
   else if(stmt.elseStatement){
      if(stmt.elseStatement->expr) ifStatement(*stmt.elseStatement);
-     else {
-       variables.push_back({});
-       for(size_t i = 0; i < stmt.elseStatement->Instructions->statements.size(); i++){
-         matchStatement(*stmt.elseStatement->Instructions->statements[i]);
-         }
-       variables.pop_back();
-     }
+     else enter(*stmt.elseStatement->Instructions);
   } 
 }
 
-void Interpreter::whileloop(const While& stmt){
-  while(isTrue(eval(*stmt.expr))) {
-    variables.push_back({});
-    for(size_t i = 0;i < stmt.Instructions -> statements.size(); i++){
-      matchStatement(*stmt.Instructions->statements[i]);
-    }
-    variables.pop_back();
+void Interpreter::switchStatement(const Switch& stmt){
+  auto value = findVar(stmt.name, stmt.slot);
+  if(!value || (value->type != Datatype::Int && value->type != Datatype::Char && value->type != Datatype::Bool) || isBig(*value)){
+    ifStatement(*stmt.chain);
+    return;
   }
+  if(auto body = stmt.find(toInt(*value))) enter(*body);
 }
 
-void Interpreter::forbody(Value*& Initial, const short& direction, const For& stmt){
-  variables.push_back({});
-    for(size_t i = 0; i<stmt.Instructions -> statements.size();i++){
-    matchStatement(*stmt.Instructions->statements[i]);
-    }
-    variables.pop_back();
-    Initial = findVar(stmt.Initialvalue->name);
+void Interpreter::whileloop(const While& stmt){
+  if(condition(*stmt.expr)) enter(*stmt.Instructions, &stmt);
+}
+
+void Interpreter::forstep(Value*& Initial, const short& direction, const For& stmt){
+    Initial = findVar(stmt.Initialvalue->name, stmt.Initialvalue->slot);
+    if(trace) trace->record(TraceKind::Iteration, stmt.location, *Initial);
     if(stmt.step == nullptr){
       std::visit([direction](auto& a){
           using T = std::decay_t<decltype(a)>;
@@ -339,18 +870,84 @@ void Interpreter::forbody(Value*& Initial, const short& direction, const For& st
     }
 }
 
-void Interpreter::forloop(const For& stmt){
-  variables.push_back({});
-  if(stmt.Initialvalue->value == nullptr){
-    if(!findVar(stmt.Initialvalue->name)){
-      variables.back()[stmt.Initialvalue->name] = {Datatype::Int, 0};
+bool Interpreter::forCondition(const For& stmt, int64_t current, int64_t Final, short direction){
+  switch(stmt.op){
+    case Operator::Arrow:
+      return (Final - current) * direction > 0;
+    case Operator::ArrowEq:
+      return (Final - current) * direction >= 0;
+    case Operator::NotEqual:
+      return current != Final;
+    case Operator::Greater:
+      return current > Final;
+    case Operator::Less:
+      return current < Final;
+    case Operator::GreaterEq:
+      return current >= Final;
+    case Operator::LessEq:
+      return current <= Final;
+    default:
+      return false;
+  }
+}
+
+void Interpreter::parallelFor(const For& stmt, Value*& Initial, int64_t Final, short direction){
+  std::vector <Value> iterations;
+  while(forCondition(stmt, toInt(*Initial), Final, direction)){
+    iterations.push_back(*Initial);
+    forstep(Initial, direction, stmt);
+  }
+  std::vector <std::ostringstream> outputs(iterations.size());
+  std::vector <std::exception_ptr> errors(iterations.size());
+  std::vector <uint64_t> used(iterations.size());
+  auto tracker = MemoryTracker::active();
+  ThreadPool::shared().run(iterations.size(), [&](size_t index){
+    auto previous = std::exchange(MemoryTracker::active(), tracker);
+    try{
+      Interpreter worker;
+      worker.parent = this;
+      worker.trace = trace;
+      worker.fuel = fuel;
+      worker.reserve = reserve;
+      worker.deadline = deadline;
+      worker.out = &outputs[index];
+      worker.variables.push_back({});
+      worker.variables.back()[stmt.Initialvalue->name] = iterations[index];
+      worker.enter(*stmt.Instructions);
+      worker.resume(SIZE_MAX);
+      used[index] = fuel + reserve - worker.fuel - worker.reserve;
+    }
+    catch(...){
+      errors[index] = std::current_exception();
     }
+    MemoryTracker::active() = previous;
+  });
+  for(size_t i = 0; i < iterations.size(); i++){
+    *out << outputs[i].str();
+    if(errors[i]) std::rethrow_exception(errors[i]);
+  }
+  // Every worker started with the whole remaining budget; the loop is charged what they used together.
+  uint64_t total = 0;
+  for(auto steps : used) total += steps;
+  if(total >= fuel + reserve) throw interpreter_error("The step limit is exceeded", stmt.location.line, stmt.location.column);
+  if(total <= reserve) reserve -= total;
+  else{
+    fuel -= total - reserve;
+    reserve = 0;
+  }
+}
+
+void Interpreter::forloop(const For& stmt){
+  auto& iterator = *stmt.Initialvalue;
+  if(!locals) variables.push_back({});
+  if(iterator.value == nullptr){
+    if(!findVar(iterator.name, iterator.slot)) declare(iterator.name, iterator.slot) = {Datatype::Int, 0};
   }
   else{
     definition(*stmt.Initialvalue);
   }
   short direction = -1;
-   auto Initial = findVar(stmt.Initialvalue->name);
+   auto Initial = findVar(iterator.name, iterator.slot);
    int64_t Final;
    if(auto a = eval(*stmt.Finalvalue); isNumeric(a) && isNumeric(*Initial)){
     Final = toInt(a);
@@ -366,44 +963,176 @@ void Interpreter::forloop(const For& stmt){
     direction = 1;
   }
   else throw interpreter_error("Invalid operator", stmt.location.line);
-  switch(stmt.op){
-    case Operator::Arrow:
-      while((Final - toInt(*Initial)) * direction > 0){forbody(Initial, direction, stmt);}
-      break;
-    case Operator::ArrowEq:
-      while((Final - toInt(*Initial)) * direction >= 0){forbody(Initial, direction, stmt);}
-      break;
-    case Operator::NotEqual:
-      while(toInt(*Initial) != Final){forbody(Initial, direction, stmt);}
-      break;
-    case Operator::Greater:
-      while(toInt(*Initial) > Final){forbody(Initial, direction, stmt);}
-      break;
-    case Operator::Less:
-      while(toInt(*Initial) < Final){forbody(Initial, direction, stmt);}
-      break;
-    case Operator::GreaterEq:
-      while(toInt(*Initial) >= Final){forbody(Initial, direction, stmt);}
-      break;
-    case Operator::LessEq:
-      while(toInt(*Initial) <= Final){forbody(Initial, direction, stmt);}
-      break;
+  if(stmt.parallel && parent == nullptr) parallelFor(stmt, Initial, Final, direction);
+  else if(forCondition(stmt, toInt(*Initial), Final, direction)){
+    enter(*stmt.Instructions, &stmt);
+    frames.back().iterator = Initial;
+    frames.back().Final = Final;
+    frames.back().direction = direction;
+    return;
   }
- variables.pop_back();
+  if(!locals) variables.pop_back();
 }
 
 void Interpreter::matchStatement(const Statement& stmt){
-  if (auto a = dynamic_cast<const Output*> (&stmt)) output(*a);
-  else if (auto a = dynamic_cast<const Input*> (&stmt)) input(*a);
+  try{
+  if (auto a = dynamic_cast<const Output*> (&stmt)) {
+    if(trace) trace->record(TraceKind::Output, stmt.location);
+    output(*a);
+  }
+  else if (auto a = dynamic_cast<const OutputText*> (&stmt)) {
+    if(trace) trace->record(TraceKind::Output, stmt.location);
+    *out << a->text;
+  }
+  else if (auto a = dynamic_cast<const Input*> (&stmt)) {
+    if(trace) trace->record(TraceKind::Input, stmt.location);
+    input(*a);
+  }
+  else if (auto a = dynamic_cast<const Update*> (&stmt)) update(*a);
   else if (auto a = dynamic_cast<const Definition*> (&stmt)) definition(*a);
-  else if (auto a = dynamic_cast<const IfStatement*> (&stmt)) ifStatement(*a);
-  else if (auto a = dynamic_cast<const While*> (&stmt)) whileloop(*a); 
-  else if (auto a = dynamic_cast<const For*> (&stmt)) forloop(*a);
+  else if (auto a = dynamic_cast<const ElementDefinition*> (&stmt)) elementDefinition(*a);
+  else if (auto a = dynamic_cast<const CallStatement*> (&stmt)) callStatement(*a);
+  else if (auto a = dynamic_cast<const IfStatement*> (&stmt)) {
+    if(trace) trace->record(TraceKind::If, stmt.location);
+    ifStatement(*a);
+  }
+  else if (auto a = dynamic_cast<const Switch*> (&stmt)) {
+    if(trace) trace->record(TraceKind::If, stmt.location);
+    switchStatement(*a);
+  }
+  else if (auto a = dynamic_cast<const While*> (&stmt)) {
+    if(trace) trace->record(TraceKind::While, stmt.location);
+    whileloop(*a); 
+  }
+  else if (auto a = dynamic_cast<const For*> (&stmt)) {
+    if(trace) trace->record(TraceKind::For, stmt.location);
+    forloop(*a);
+  }
+  else if (auto a = dynamic_cast<const Return*> (&stmt)) returnStatement(*a);
+  else if (auto a = dynamic_cast<const Function*> (&stmt)) functionDefinition(*a);
+  else if (auto a = dynamic_cast<const Release*> (&stmt)) release(*a);
+  }
+  catch(const memory_limit_error& err){
+    throw interpreter_error(err.what(), stmt.location.line, stmt.location.column);
+  }
 }
 
-void Interpreter::execute(const Program& program){
-    variables.push_back({});
-    for(size_t i = 0; i < program.statements.size(); i++){
-      matchStatement(*program.statements[i]);
+void Interpreter::setTrace(TraceBuffer* buffer){
+  trace = buffer;
+}
+
+void Interpreter::setStreams(std::istream& input, std::ostream& output){
+  in = &input;
+  out = &output;
+}
+
+void Interpreter::setInput(InputChannel* input){
+  channel = input;
+}
+
+void Interpreter::onStall(std::function<void()> callback){
+  stallHandler = std::move(callback);
+}
+
+void Interpreter::stall(){
+  if(!stalled && stallHandler) stallHandler();
+  stalled = true;
+  budget = SIZE_MAX;
+}
+
+void Interpreter::bind(const std::string& name, Value value){
+  if(variables.empty()) variables.push_back({});
+  variables.front()[name] = std::move(value);
+  if(std::find(bound.begin(), bound.end(), name) == bound.end()) bound.push_back(name);
+}
+
+void Interpreter::bind(const std::string& name, std::string_view text){
+  if(!variables.empty()){
+    auto found = variables.front().find(name);
+    if(found != variables.front().end() && found->second.type == Datatype::String){
+      auto& str = std::get<Cow<String>> (found->second.data);
+      if(str.unique()){
+        str.mutate().assign(text.begin(), text.end());
+        return;
+      }
     }
+  }
+  bind(name, {Datatype::String, String(text.begin(), text.end())});
+}
+
+void Interpreter::setKeepGlobals(bool keep){
+  keepGlobals = keep;
+}
+
+void Interpreter::reset(){
+  frames.clear();
+  stack = CallStack();
+  locals = nullptr;
+  callFloor = 0;
+  depth = 0;
+  if(variables.empty()) return;
+  variables.resize(1);
+  std::erase_if(variables.front(), [&](const auto& entry){
+    return std::find(bound.begin(), bound.end(), entry.first) == bound.end();
+  });
+}
+
+void Interpreter::start(const Program& program, size_t next){
+  if(variables.empty()) variables.push_back({});
+  frames.push_back({&program, next, false});
+}
+
+Interpreter::RunState Interpreter::resume(size_t budget){
+  this->budget = budget;
+  stalled = false;
+  return run(0);
+}
+
+void Interpreter::setLimits(uint64_t steps, std::chrono::steady_clock::time_point deadline){
+  fuel = 1;
+  reserve = steps == 0 ? unmetered : steps;
+  this->deadline = deadline;
+}
+
+void Interpreter::refuel(const Location& location){
+  if(reserve == 0) throw interpreter_error("The step limit is exceeded", location.line, location.column);
+  if(deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline){
+    throw interpreter_error("The time limit is exceeded", location.line, location.column);
+  }
+  fuel = std::min(reserve, meterInterval);
+  reserve -= fuel;
+}
+
+Interpreter::RunState Interpreter::run(size_t floor){
+  while(frames.size() > floor){
+    if(floor == 0 && (budget == 0 || stalled)) return RunState::Preempted;
+    if(budget == 0) stall();
+    budget--;
+    auto& frame = frames.back();
+    if(frame.next == frame.body->statements.size()){
+      auto loop = frame.loop;
+      if(metered && loop && --fuel == 0) refuel(loop->location);
+      if(frame.scoped) variables.pop_back();
+      bool again = false;
+      try{
+        again = repeat(frames.size() - 1);
+      }
+      catch(const memory_limit_error& err){
+        throw interpreter_error(err.what(), loop->location.line, loop->location.column);
+      }
+      if(!again) frames.pop_back();
+      continue;
+    }
+    auto& stmt = *frame.body->statements[frame.next];
+    if(floor == 0 && channel && !inputFile && dynamic_cast<const Input*> (&stmt) && !channel->ready()) return RunState::Waiting;
+    if(metered && --fuel == 0) refuel(stmt.location);
+    frame.next++;
+    matchStatement(stmt);
+  }
+  return RunState::Finished;
+}
+
+void Interpreter::execute(const Program& program){
+  start(program);
+  resume(SIZE_MAX);
 }
@@ -0,0 +1,428 @@
+#include "kernels.h"
+#include <algorithm>
+#include <bit>
+#include <string_view>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DOUBLEC_X86 1
+#endif
+
+namespace kernels{
+
+enum class Isa{
+  Scalar,
+  SSE2,
+  AVX2
+};
+
+static Isa detect(){
+#ifdef DOUBLEC_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return Isa::AVX2;
+  if(__builtin_cpu_supports("sse2")) return Isa::SSE2;
+#endif
+  return Isa::Scalar;
+}
+
+static Isa& selected(){
+  static Isa isa = detect();
+  return isa;
+}
+
+static Isa level(){
+  return selected();
+}
+
+bool select(const char* name){
+  std::string_view wanted(name);
+  Isa isa;
+  if(wanted == "scalar") isa = Isa::Scalar;
+  else if(wanted == "sse2") isa = Isa::SSE2;
+  else if(wanted == "avx2") isa = Isa::AVX2;
+  else return false;
+  if(isa > detect()) return false;
+  selected() = isa;
+  return true;
+}
+
+const char* isa(){
+  switch(level()){
+    case Isa::AVX2: return "avx2";
+    case Isa::SSE2: return "sse2";
+    default: return "scalar";
+  }
+}
+
+template <typename T>
+static T apply(Operator op, T left, T right){
+  if constexpr (std::is_integral_v<T>){
+    auto a = static_cast<uint64_t> (left), b = static_cast<uint64_t> (right);
+    switch(op){
+      case Operator::Add: return static_cast<T> (a + b);
+      case Operator::Sub: return static_cast<T> (a - b);
+      case Operator::Mul: return static_cast<T> (a * b);
+      default: return 0;
+    }
+  }
+  else{
+    switch(op){
+      case Operator::Add: return left + right;
+      case Operator::Sub: return left - right;
+      case Operator::Mul: return left * right;
+      case Operator::Div: return left / right;
+      default: return 0;
+    }
+  }
+}
+
+template <typename T>
+static bool test(Operator op, T left, T right){
+  switch(op){
+    case Operator::Less: return left < right;
+    case Operator::Greater: return left > right;
+    case Operator::LessEq: return left <= right;
+    case Operator::GreaterEq: return left >= right;
+    case Operator::Equal: return left == right;
+    case Operator::NotEqual: return left != right;
+    default: return false;
+  }
+}
+
+template <typename T>
+static void arithmeticTail(Operator op, const T* left, bool leftScalar, const T* right, bool rightScalar, T* result, size_t i, size_t size){
+  for(; i < size; i++) result[i] = apply(op, left[leftScalar ? 0 : i], right[rightScalar ? 0 : i]);
+}
+
+template <typename T>
+static void compareTail(Operator op, const T* left, bool leftScalar, const T* right, bool rightScalar, char* result, size_t i, size_t size){
+  for(; i < size; i++) result[i] = test(op, left[leftScalar ? 0 : i], right[rightScalar ? 0 : i]);
+}
+
+#ifdef DOUBLEC_X86
+__attribute__((target("avx2")))
+static size_t arithmeticAVX2(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, double* result, size_t size){
+  size_t i = 0;
+  for(; i + 4 <= size; i += 4){
+    __m256d a = leftScalar ? _mm256_set1_pd(*left) : _mm256_loadu_pd(left + i);
+    __m256d b = rightScalar ? _mm256_set1_pd(*right) : _mm256_loadu_pd(right + i);
+    switch(op){
+      case Operator::Add: a = _mm256_add_pd(a, b); break;
+      case Operator::Sub: a = _mm256_sub_pd(a, b); break;
+      case Operator::Mul: a = _mm256_mul_pd(a, b); break;
+      case Operator::Div: a = _mm256_div_pd(a, b); break;
+      default: return i;
+    }
+    _mm256_storeu_pd(result + i, a);
+  }
+  return i;
+}
+
+static size_t arithmeticSSE2(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, double* result, size_t size){
+  size_t i = 0;
+  for(; i + 2 <= size; i += 2){
+    __m128d a = leftScalar ? _mm_set1_pd(*left) : _mm_loadu_pd(left + i);
+    __m128d b = rightScalar ? _mm_set1_pd(*right) : _mm_loadu_pd(right + i);
+    switch(op){
+      case Operator::Add: a = _mm_add_pd(a, b); break;
+      case Operator::Sub: a = _mm_sub_pd(a, b); break;
+      case Operator::Mul: a = _mm_mul_pd(a, b); break;
+      case Operator::Div: a = _mm_div_pd(a, b); break;
+      default: return i;
+    }
+    _mm_storeu_pd(result + i, a);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static size_t arithmeticAVX2(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, int64_t* result, size_t size){
+  if(op != Operator::Add && op != Operator::Sub) return 0;
+  size_t i = 0;
+  for(; i + 4 <= size; i += 4){
+    __m256i a = leftScalar ? _mm256_set1_epi64x(*left) : _mm256_loadu_si256(reinterpret_cast<const __m256i*> (left + i));
+    __m256i b = rightScalar ? _mm256_set1_epi64x(*right) : _mm256_loadu_si256(reinterpret_cast<const __m256i*> (right + i));
+    a = op == Operator::Add ? _mm256_add_epi64(a, b) : _mm256_sub_epi64(a, b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*> (result + i), a);
+  }
+  return i;
+}
+
+static size_t arithmeticSSE2(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, int64_t* result, size_t size){
+  if(op != Operator::Add && op != Operator::Sub) return 0;
+  size_t i = 0;
+  for(; i + 2 <= size; i += 2){
+    __m128i a = leftScalar ? _mm_set1_epi64x(*left) : _mm_loadu_si128(reinterpret_cast<const __m128i*> (left + i));
+    __m128i b = rightScalar ? _mm_set1_epi64x(*right) : _mm_loadu_si128(reinterpret_cast<const __m128i*> (right + i));
+    a = op == Operator::Add ? _mm_add_epi64(a, b) : _mm_sub_epi64(a, b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*> (result + i), a);
+  }
+  return i;
+}
+
+static void storeMask(int mask, char* result, int lanes){
+  for(int k = 0; k < lanes; k++) result[k] = (mask >> k) & 1;
+}
+
+__attribute__((target("avx2")))
+static size_t compareAVX2(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, char* result, size_t size){
+  size_t i = 0;
+  for(; i + 4 <= size; i += 4){
+    __m256d a = leftScalar ? _mm256_set1_pd(*left) : _mm256_loadu_pd(left + i);
+    __m256d b = rightScalar ? _mm256_set1_pd(*right) : _mm256_loadu_pd(right + i);
+    switch(op){
+      case Operator::Less: a = _mm256_cmp_pd(a, b, _CMP_LT_OQ); break;
+      case Operator::Greater: a = _mm256_cmp_pd(a, b, _CMP_GT_OQ); break;
+      case Operator::LessEq: a = _mm256_cmp_pd(a, b, _CMP_LE_OQ); break;
+      case Operator::GreaterEq: a = _mm256_cmp_pd(a, b, _CMP_GE_OQ); break;
+      case Operator::Equal: a = _mm256_cmp_pd(a, b, _CMP_EQ_OQ); break;
+      case Operator::NotEqual: a = _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); break;
+      default: return i;
+    }
+    storeMask(_mm256_movemask_pd(a), result + i, 4);
+  }
+  return i;
+}
+
+static size_t compareSSE2(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, char* result, size_t size){
+  size_t i = 0;
+  for(; i + 2 <= size; i += 2){
+    __m128d a = leftScalar ? _mm_set1_pd(*left) : _mm_loadu_pd(left + i);
+    __m128d b = rightScalar ? _mm_set1_pd(*right) : _mm_loadu_pd(right + i);
+    switch(op){
+      case Operator::Less: a = _mm_cmplt_pd(a, b); break;
+      case Operator::Greater: a = _mm_cmpgt_pd(a, b); break;
+      case Operator::LessEq: a = _mm_cmple_pd(a, b); break;
+      case Operator::GreaterEq: a = _mm_cmpge_pd(a, b); break;
+      case Operator::Equal: a = _mm_cmpeq_pd(a, b); break;
+      case Operator::NotEqual: a = _mm_cmpneq_pd(a, b); break;
+      default: return i;
+    }
+    storeMask(_mm_movemask_pd(a), result + i, 2);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static size_t compareAVX2(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, char* result, size_t size){
+  size_t i = 0;
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  for(; i + 4 <= size; i += 4){
+    __m256i a = leftScalar ? _mm256_set1_epi64x(*left) : _mm256_loadu_si256(reinterpret_cast<const __m256i*> (left + i));
+    __m256i b = rightScalar ? _mm256_set1_epi64x(*right) : _mm256_loadu_si256(reinterpret_cast<const __m256i*> (right + i));
+    __m256i c;
+    switch(op){
+      case Operator::Less: c = _mm256_cmpgt_epi64(b, a); break;
+      case Operator::Greater: c = _mm256_cmpgt_epi64(a, b); break;
+      case Operator::LessEq: c = _mm256_xor_si256(_mm256_cmpgt_epi64(a, b), ones); break;
+      case Operator::GreaterEq: c = _mm256_xor_si256(_mm256_cmpgt_epi64(b, a), ones); break;
+      case Operator::Equal: c = _mm256_cmpeq_epi64(a, b); break;
+      case Operator::NotEqual: c = _mm256_xor_si256(_mm256_cmpeq_epi64(a, b), ones); break;
+      default: return i;
+    }
+    storeMask(_mm256_movemask_pd(_mm256_castsi256_pd(c)), result + i, 4);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static double sumAVX2(const double* data, size_t size, size_t& i){
+  __m256d total = _mm256_setzero_pd();
+  for(i = 0; i + 4 <= size; i += 4) total = _mm256_add_pd(total, _mm256_loadu_pd(data + i));
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, total);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+static double sumSSE2(const double* data, size_t size, size_t& i){
+  __m128d total = _mm_setzero_pd();
+  for(i = 0; i + 2 <= size; i += 2) total = _mm_add_pd(total, _mm_loadu_pd(data + i));
+  alignas(16) double lanes[2];
+  _mm_store_pd(lanes, total);
+  return lanes[0] + lanes[1];
+}
+
+__attribute__((target("avx2")))
+static int64_t sumAVX2(const int64_t* data, size_t size, size_t& i){
+  __m256i total = _mm256_setzero_si256();
+  for(i = 0; i + 4 <= size; i += 4) total = _mm256_add_epi64(total, _mm256_loadu_si256(reinterpret_cast<const __m256i*> (data + i)));
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*> (lanes), total);
+  return static_cast<int64_t> (static_cast<uint64_t> (lanes[0]) + lanes[1] + lanes[2] + lanes[3]);
+}
+
+static int64_t sumSSE2(const int64_t* data, size_t size, size_t& i){
+  __m128i total = _mm_setzero_si128();
+  for(i = 0; i + 2 <= size; i += 2) total = _mm_add_epi64(total, _mm_loadu_si128(reinterpret_cast<const __m128i*> (data + i)));
+  alignas(16) int64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*> (lanes), total);
+  return static_cast<int64_t> (static_cast<uint64_t> (lanes[0]) + lanes[1]);
+}
+
+__attribute__((target("avx2")))
+static double extremeAVX2(const double* data, size_t size, size_t& i, bool minimum){
+  __m256d best = _mm256_loadu_pd(data);
+  for(i = 4; i + 4 <= size; i += 4){
+    __m256d next = _mm256_loadu_pd(data + i);
+    best = minimum ? _mm256_min_pd(best, next) : _mm256_max_pd(best, next);
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, best);
+  return minimum ? std::min({lanes[0], lanes[1], lanes[2], lanes[3]}) : std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+}
+
+static double extremeSSE2(const double* data, size_t size, size_t& i, bool minimum){
+  __m128d best = _mm_loadu_pd(data);
+  for(i = 2; i + 2 <= size; i += 2){
+    __m128d next = _mm_loadu_pd(data + i);
+    best = minimum ? _mm_min_pd(best, next) : _mm_max_pd(best, next);
+  }
+  alignas(16) double lanes[2];
+  _mm_store_pd(lanes, best);
+  return minimum ? std::min(lanes[0], lanes[1]) : std::max(lanes[0], lanes[1]);
+}
+
+__attribute__((target("avx2")))
+static int64_t extremeAVX2(const int64_t* data, size_t size, size_t& i, bool minimum){
+  __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (data));
+  for(i = 4; i + 4 <= size; i += 4){
+    __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (data + i));
+    __m256i replace = minimum ? _mm256_cmpgt_epi64(best, next) : _mm256_cmpgt_epi64(next, best);
+    best = _mm256_blendv_epi8(best, next, replace);
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*> (lanes), best);
+  return minimum ? std::min({lanes[0], lanes[1], lanes[2], lanes[3]}) : std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+}
+
+__attribute__((target("avx2")))
+static size_t countAVX2(const char* data, size_t size, size_t& i){
+  size_t total = 0;
+  const __m256i zero = _mm256_setzero_si256();
+  for(i = 0; i + 32 <= size; i += 32){
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (data + i));
+    total += 32 - std::popcount(static_cast<uint32_t> (_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero))));
+  }
+  return total;
+}
+
+static size_t countSSE2(const char* data, size_t size, size_t& i){
+  size_t total = 0;
+  const __m128i zero = _mm_setzero_si128();
+  for(i = 0; i + 16 <= size; i += 16){
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*> (data + i));
+    total += 16 - std::popcount(static_cast<uint32_t> (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero))));
+  }
+  return total;
+}
+#endif
+
+void arithmetic(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, double* result, size_t size){
+  size_t i = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) i = arithmeticAVX2(op, left, leftScalar, right, rightScalar, result, size);
+  else if(level() == Isa::SSE2) i = arithmeticSSE2(op, left, leftScalar, right, rightScalar, result, size);
+#endif
+  arithmeticTail(op, left, leftScalar, right, rightScalar, result, i, size);
+}
+
+void arithmetic(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, int64_t* result, size_t size){
+  size_t i = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) i = arithmeticAVX2(op, left, leftScalar, right, rightScalar, result, size);
+  else if(level() == Isa::SSE2) i = arithmeticSSE2(op, left, leftScalar, right, rightScalar, result, size);
+#endif
+  arithmeticTail(op, left, leftScalar, right, rightScalar, result, i, size);
+}
+
+void compare(Operator op, const double* left, bool leftScalar, const double* right, bool rightScalar, char* result, size_t size){
+  size_t i = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) i = compareAVX2(op, left, leftScalar, right, rightScalar, result, size);
+  else if(level() == Isa::SSE2) i = compareSSE2(op, left, leftScalar, right, rightScalar, result, size);
+#endif
+  compareTail(op, left, leftScalar, right, rightScalar, result, i, size);
+}
+
+void compare(Operator op, const int64_t* left, bool leftScalar, const int64_t* right, bool rightScalar, char* result, size_t size){
+  size_t i = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) i = compareAVX2(op, left, leftScalar, right, rightScalar, result, size);
+#endif
+  compareTail(op, left, leftScalar, right, rightScalar, result, i, size);
+}
+
+double sum(const double* data, size_t size){
+  size_t i = 0;
+  double total = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) total = sumAVX2(data, size, i);
+  else if(level() == Isa::SSE2) total = sumSSE2(data, size, i);
+#endif
+  for(; i < size; i++) total += data[i];
+  return total;
+}
+
+int64_t sum(const int64_t* data, size_t size){
+  size_t i = 0;
+  uint64_t total = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) total = sumAVX2(data, size, i);
+  else if(level() == Isa::SSE2) total = sumSSE2(data, size, i);
+#endif
+  for(; i < size; i++) total += data[i];
+  return static_cast<int64_t> (total);
+}
+
+template <typename T>
+static T extreme(const T* data, size_t size, size_t i, T best, bool minimum){
+  for(; i < size; i++) best = minimum ? std::min(best, data[i]) : std::max(best, data[i]);
+  return best;
+}
+
+double min(const double* data, size_t size){
+#ifdef DOUBLEC_X86
+  size_t i = 0;
+  if(level() == Isa::AVX2 && size >= 4) return extreme(data, size, i, extremeAVX2(data, size, i, true), true);
+  if(level() == Isa::SSE2 && size >= 2) return extreme(data, size, i, extremeSSE2(data, size, i, true), true);
+#endif
+  return extreme(data, size, 1, data[0], true);
+}
+
+double max(const double* data, size_t size){
+#ifdef DOUBLEC_X86
+  size_t i = 0;
+  if(level() == Isa::AVX2 && size >= 4) return extreme(data, size, i, extremeAVX2(data, size, i, false), false);
+  if(level() == Isa::SSE2 && size >= 2) return extreme(data, size, i, extremeSSE2(data, size, i, false), false);
+#endif
+  return extreme(data, size, 1, data[0], false);
+}
+
+int64_t min(const int64_t* data, size_t size){
+#ifdef DOUBLEC_X86
+  size_t i = 0;
+  if(level() == Isa::AVX2 && size >= 4) return extreme(data, size, i, extremeAVX2(data, size, i, true), true);
+#endif
+  return extreme(data, size, 1, data[0], true);
+}
+
+int64_t max(const int64_t* data, size_t size){
+#ifdef DOUBLEC_X86
+  size_t i = 0;
+  if(level() == Isa::AVX2 && size >= 4) return extreme(data, size, i, extremeAVX2(data, size, i, false), false);
+#endif
+  return extreme(data, size, 1, data[0], false);
+}
+
+size_t count(const char* data, size_t size){
+  size_t i = 0;
+  size_t total = 0;
+#ifdef DOUBLEC_X86
+  if(level() == Isa::AVX2) total = countAVX2(data, size, i);
+  else if(level() == Isa::SSE2) total = countSSE2(data, size, i);
+#endif
+  for(; i < size; i++) total += data[i] != 0;
+  return total;
+}
+
+}
@@ -1,16 +1,11 @@
 #include "lexer.h"
+#include <algorithm>
 
-void Lexer::readFile(std::string name){
+void Lexer::load(const std::string& source){
   std::string line;
-  std::ifstream in(name);
-  if(in.is_open()){
-    while(std::getline(in, line)){
-      Initialcode.push_back(line);
-    }
-  }
-  else{
-    std::cout << "Cannot open/find such file\n";
-    std::exit(1);
+  std::istringstream in(source);
+  while(std::getline(in, line)){
+    Initialcode.push_back(line);
   }
 }
 
@@ -136,7 +131,10 @@ bool Lexer::isOperator(){
       case '<':
       case '=':
       case '!':
-      if(Initialcode[i][pos + 1] == '=') tokens.back().emplace_back(TokenType::Operator, Keyword::amount, std::string(1, Initialcode[i][pos]) + "=", i + 1, ++pos + 1);
+      if(Initialcode[i][pos + 1] == '='){
+        std::string lexeme = std::string(1, Initialcode[i][pos]) + "=";
+        tokens.back().emplace_back(TokenType::Operator, Keyword::amount, lexeme, i + 1, ++pos + 1);
+      }
       else tokens.back().emplace_back(TokenType::Operator, Keyword::amount, std::string(1, Initialcode[i][pos]), i + 1, pos +1);
       return true;
     }
@@ -149,6 +147,7 @@ bool Lexer::isSeparator(){
         case ')':
         case ':':
         case ';':
+        case ',':
         case '[':
         case ']':
         case '{':
@@ -160,9 +159,8 @@ bool Lexer::isSeparator(){
       return false;
 }
 
-std::vector <std::vector <Token>> Lexer::Tokenize(){
-   for(i = 0; i < Initialcode.size(); i++){
-    if (Initialcode[i].size() == 0 ) continue;
+void Lexer::TokenizeLine(){
+    if (Initialcode[i].size() == 0 ) return;
    tokens.emplace_back();
     for(pos = 0; pos < Initialcode[i].size(); pos++){
       if(std::isspace(Initialcode[i][pos])) continue;
@@ -174,8 +172,19 @@ std::vector <std::vector <Token>> Lexer::Tokenize(){
       else throw std::invalid_argument("Invalid symbol at line " + std::to_string(i) + "; column: " + std::to_string(pos));
     }
     tokens.back().emplace_back(TokenType::End, Keyword::amount, "", i + 1, Initialcode[i].size() + 1);
-   }
+}
+
+std::vector <std::vector <Token>> Lexer::Tokenize(){
+   for(i = 0; i < Initialcode.size(); i++) TokenizeLine();
     return tokens;
 }
 
+std::vector <std::vector <Token>> Lexer::Tokenize(size_t lines){
+  tokens.clear();
+  for(size_t end = std::min(Initialcode.size(), i + lines); i < end; i++) TokenizeLine();
+  return std::move(tokens);
+}
 
+bool Lexer::done() const{
+  return i == Initialcode.size();
+}
@@ -1,38 +1,158 @@
+#include <chrono>
 #include <iostream>
-#include "lexer.h"
-#include "AST.h"
-#include "parser.h"
-#include "interpreter.h"
+#include "doublec.h"
+#include "batch.h"
+#include "trace.h"
+#include "cache.h"
 
 int main(int argc, char* argv[]){
+  MemoryTracker tracker;
+  MemoryTracker::active() = &tracker;
+  bool memoryReport = false;
+  std::unique_ptr <TraceBuffer> trace;
+  std::string traceFile = "doublec.trace";
+  bool useCache = true;
+  std::string cacheDir;
+  int code = 0;
+  std::shared_ptr <const doublec::CompiledProgram> program;
+  auto dumpTrace = [&](){
+    if(!trace) return;
+    try{
+      trace->dump(traceFile);
+      std::cerr << "Trace written to " << traceFile << std::endl;
+    }
+    catch(const std::runtime_error& err){
+      std::cerr << err.what() << std::endl;
+    }
+  };
   try{
-    if(argc == 1) {
+    std::string path;
+    std::string manifest;
+    size_t slice = 10000;
+    doublec::Limits limits;
+    bool eachLine = false;
+    bool keepState = false;
+    bool pipeline = false;
+    auto parsing = doublec::Parsing::Eager;
+    std::string beginPath;
+    for(int i = 1; i < argc; i++){
+      std::string arg = argv[i];
+      if(arg == "--memory-report") memoryReport = true;
+      else if(arg == "--max-memory" && i + 1 < argc){
+        try{
+          tracker.limit = parseMemorySize(argv[++i]);
+        }
+        catch(const std::exception&){
+          std::cout << "Invalid memory limit: " << argv[i] << "\n";
+          return -4;
+        }
+      }
+      else if(arg == "--trace" && i + 1 < argc){
+        try{
+          trace = std::make_unique <TraceBuffer> (std::stoull(argv[++i]));
+        }
+        catch(const std::exception&){
+          std::cout << "Invalid trace size: " << argv[i] << "\n";
+          return -4;
+        }
+      }
+      else if(arg == "--trace-file" && i + 1 < argc) traceFile = argv[++i];
+      else if(arg == "--no-cache") useCache = false;
+      else if(arg == "--cache-dir" && i + 1 < argc) cacheDir = argv[++i];
+      else if(arg == "--batch" && i + 1 < argc) manifest = argv[++i];
+      else if(arg == "--each-line") eachLine = true;
+      else if(arg == "--keep-state") keepState = true;
+      else if(arg == "--pipeline") pipeline = true;
+      else if(arg == "--lazy") parsing = doublec::Parsing::Lazy;
+      else if(arg == "--lazy-unchecked") parsing = doublec::Parsing::LazyUnchecked;
+      else if(arg == "--begin" && i + 1 < argc) beginPath = argv[++i];
+      else if(arg == "--max-steps" && i + 1 < argc){
+        try{
+          limits.steps = std::stoull(argv[++i]);
+        }
+        catch(const std::exception&){
+          std::cout << "Invalid step limit: " << argv[i] << "\n";
+          return -4;
+        }
+      }
+      else if(arg == "--timeout" && i + 1 < argc){
+        try{
+          limits.timeout = std::chrono::duration <double> (std::stod(argv[++i]));
+        }
+        catch(const std::exception&){
+          std::cout << "Invalid timeout: " << argv[i] << "\n";
+          return -4;
+        }
+      }
+      else if(arg == "--slice" && i + 1 < argc){
+        try{
+          slice = std::stoull(argv[++i]);
+        }
+        catch(const std::exception&){
+          std::cout << "Invalid slice: " << argv[i] << "\n";
+          return -4;
+        }
+      }
+      else if(arg.rfind("--", 0) == 0){
+        std::cout << "Unknown option: " << arg << "\n";
+        return -4;
+      }
+      else path = arg;
+    }
+    if(path.empty() && manifest.empty()) {
       std::cout << "The path is expected to be provided\n";
       return -4;
     }
-    std::string path = argv[1];
-    Program program;
-    Lexer lexer;
-    lexer.readFile(path);
-    auto tokens = lexer.Tokenize();
-    Parser parser(tokens);
-    parser.Parse(program);
-    Interpreter interpreter;
-    interpreter.execute(program);
-  }
-  catch(const std::invalid_argument& err){
-    std::cerr << "Syntax error: " << err.what() << std::endl;
-    return -1;
-  }
-  catch(const interpreter_error& err){
-    std::cerr << "Runtime error: "<< err.what() << " at line: " + std::to_string(err.location.line);
-    if(err.location.column != 0) std::cerr<< "; column: " + std::to_string(err.location.column);
-    std::cerr<<std::endl;
-    return -2;
+    if(cacheDir.empty()) cacheDir = ProgramCache::defaultDirectory();
+    std::unique_ptr <ProgramCache> cache;
+    if(useCache && !cacheDir.empty()) cache = std::make_unique <ProgramCache> (cacheDir);
+    if(!manifest.empty()){
+      auto jobs = doublec::readManifest(manifest);
+      auto start = std::chrono::steady_clock::now();
+      auto results = doublec::runBatch(jobs, cache.get(), tracker.limit, trace.get(), slice, limits);
+      std::chrono::duration <double> elapsed = std::chrono::steady_clock::now() - start;
+      size_t failed = 0;
+      for(size_t i = 0; i < jobs.size(); i++){
+        std::cout << results[i].output;
+        if(results[i].code == 0) continue;
+        std::cerr << jobs[i].script << ": " << results[i].error << std::endl;
+        if(failed++ == 0) code = results[i].code;
+      }
+      std::cerr << jobs.size() << " jobs, " << failed << " failed in " << elapsed.count() << " s (" << (elapsed.count() > 0 ? jobs.size() / elapsed.count() : 0) << " jobs/sec)" << std::endl;
+      if(failed != 0) dumpTrace();
+      if(memoryReport) tracker.report(std::cerr);
+      return code;
+    }
+    std::string source;
+    try{
+      source = doublec::readSource(path);
+    }
+    catch(const std::runtime_error& err){
+      std::cout << err.what() << "\n";
+      return 1;
+    }
+    doublec::Context context;
+    context.setTrace(trace.get());
+    context.setLimits(limits);
+    if(eachLine){
+      program = doublec::compile(source, cache.get(), parsing);
+      std::shared_ptr <const doublec::CompiledProgram> begin;
+      if(!beginPath.empty()) begin = doublec::compile(doublec::readSource(beginPath), cache.get(), parsing);
+      std::ios::sync_with_stdio(false);
+      context.runEachLine(*program, keepState, begin.get());
+    }
+    else if(pipeline) context.runPipelined(source);
+    else{
+      program = doublec::compile(source, cache.get(), parsing);
+      context.run(*program);
+    }
   }
-  catch(const std::runtime_error& err){
-    std::cerr << "Runtime error: " << err.what() << std::endl;
-    return -3;
+  catch(...){
+    std::string message;
+    code = doublec::formatError(std::current_exception(), message);
+    std::cerr << message << std::endl;
+    if(code != -1) dumpTrace();
   }
-  return 0;
+  if(memoryReport) tracker.report(std::cerr);
+  return code;
 }
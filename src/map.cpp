@@ -0,0 +1,166 @@
+#include "map.h"
+#include "bigint.h"
+#include <bit>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace{
+  constexpr int8_t empty = -128;
+  constexpr int8_t deleted = -2;
+  constexpr size_t groupWidth = 16;
+  constexpr size_t npos = SIZE_MAX;
+
+  struct Group{
+#ifdef __SSE2__
+    __m128i bytes;
+    explicit Group(const int8_t* data) : bytes(_mm_loadu_si128(reinterpret_cast <const __m128i*> (data))) {}
+    uint32_t match(int8_t tag) const {
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag)));
+    }
+    uint32_t available() const {
+      return _mm_movemask_epi8(bytes);
+    }
+#else
+    const int8_t* bytes;
+    explicit Group(const int8_t* data) : bytes(data) {}
+    uint32_t match(int8_t tag) const {
+      uint32_t bits = 0;
+      for(size_t i = 0; i < groupWidth; i++) bits |= static_cast <uint32_t> (bytes[i] == tag) << i;
+      return bits;
+    }
+    uint32_t available() const {
+      uint32_t bits = 0;
+      for(size_t i = 0; i < groupWidth; i++) bits |= static_cast <uint32_t> (bytes[i] < 0) << i;
+      return bits;
+    }
+#endif
+  };
+
+  uint64_t mix(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    return x ^ (x >> 33);
+  }
+
+  int64_t integer(const Value& key){
+    switch(key.type){
+      case Datatype::Char:
+        return std::get <char> (key.data);
+      case Datatype::Bool:
+        return std::get <bool> (key.data);
+      default:
+        return std::get <int64_t> (key.data);
+    }
+  }
+
+  uint64_t hashKey(const Value& key){
+    if(auto big = std::get_if <Cow <BigInt>> (&key.data)) return mix((*big)->hash());
+    if(key.type != Datatype::String) return mix(static_cast <uint64_t> (integer(key)));
+    auto& str = *std::get <Cow <String>> (key.data);
+    return mix(std::hash <std::string_view> ()(std::string_view(str.data(), str.size())));
+  }
+
+  // mix() is a bijection, so int, char and bool keys with equal hashes are equal; only strings and big ints need comparing.
+  // A big int is never == to an inline one, since only values outside the int64_t range are stored as BigInt.
+  bool sameKey(const Value& stored, const Value& key){
+    auto big = std::get_if <Cow <BigInt>> (&key.data);
+    auto storedBig = std::get_if <Cow <BigInt>> (&stored.data);
+    if(big || storedBig) return big && storedBig && **big == **storedBig;
+    if(key.type != Datatype::String) return stored.type != Datatype::String;
+    return stored.type == Datatype::String && *std::get <Cow <String>> (stored.data) == *std::get <Cow <String>> (key.data);
+  }
+
+  int8_t tagOf(uint64_t hash){
+    return static_cast <int8_t> (hash & 0x7F);
+  }
+
+  void checkKey(const Value& key){
+    if(!Map::validKey(key)) throw std::runtime_error("The map key must be an int, char, bool or string");
+  }
+}
+
+bool Map::validKey(const Value& key){
+  return key.type == Datatype::Int || key.type == Datatype::Char || key.type == Datatype::Bool || key.type == Datatype::String;
+}
+
+size_t Map::locate(const Value& key, uint64_t hash) const{
+  if(control.empty()) return npos;
+  size_t mask = control.size() / groupWidth - 1;
+  size_t group = (hash >> 7) & mask;
+  for(size_t step = 1;; step++){
+    Group bytes(control.data() + group * groupWidth);
+    for(auto bits = bytes.match(tagOf(hash)); bits; bits &= bits - 1){
+      auto i = group * groupWidth + std::countr_zero(bits);
+      auto& entry = entries[positions[i]];
+      if(entry.hash == hash && sameKey(entry.key, key)) return i;
+    }
+    if(bytes.match(empty)) return npos;
+    group = (group + step) & mask;
+  }
+}
+
+size_t Map::available(uint64_t hash) const{
+  size_t mask = control.size() / groupWidth - 1;
+  size_t group = (hash >> 7) & mask;
+  for(size_t step = 1;; step++){
+    if(auto bits = Group(control.data() + group * groupWidth).available()) return group * groupWidth + std::countr_zero(bits);
+    group = (group + step) & mask;
+  }
+}
+
+void Map::rehash(size_t capacity){
+  std::erase_if(entries, [](const Entry& entry){ return entry.key.type == Datatype::Invalid; });
+  entries.reserve(capacity - capacity / 8);
+  control.assign(capacity, empty);
+  positions.assign(capacity, 0);
+  growthLeft = capacity - capacity / 8 - count;
+  for(size_t i = 0; i < entries.size(); i++){
+    auto slot = available(entries[i].hash);
+    control[slot] = tagOf(entries[i].hash);
+    positions[slot] = i;
+  }
+}
+
+const Value* Map::find(const Value& key) const{
+  checkKey(key);
+  auto i = locate(key, hashKey(key));
+  return i == npos ? nullptr : &entries[positions[i]].value;
+}
+
+Value* Map::find(const Value& key){
+  return const_cast <Value*> (std::as_const(*this).find(key));
+}
+
+Value& Map::insert(const Value& key){
+  checkKey(key);
+  auto hash = hashKey(key);
+  if(auto i = locate(key, hash); i != npos) return entries[positions[i]].value;
+  if(growthLeft == 0){
+    size_t capacity = control.size();
+    rehash(capacity == 0 ? groupWidth : count >= capacity * 7 / 16 ? capacity * 2 : capacity);
+  }
+  auto i = available(hash);
+  if(control[i] == empty) growthLeft--;
+  control[i] = tagOf(hash);
+  positions[i] = entries.size();
+  entries.push_back({hash, key, Value{}});
+  count++;
+  return entries.back().value;
+}
+
+bool Map::erase(const Value& key){
+  checkKey(key);
+  auto i = locate(key, hashKey(key));
+  if(i == npos) return false;
+  control[i] = deleted;
+  if(positions[i] + 1 == entries.size()) entries.pop_back();
+  else entries[positions[i]] = {0, {Datatype::Invalid, {}}, {}};
+  count--;
+  return true;
+}
@@ -0,0 +1,128 @@
+#include "interpreter.h"
+#include <utility>
+
+static constexpr bool isNumericType(Datatype type){
+  return type == Datatype::Int || type == Datatype::Char || type == Datatype::Double || type == Datatype::Bool;
+}
+
+static constexpr bool isComparison(Operator op){
+  return op >= Operator::Less && op <= Operator::NotEqual;
+}
+
+static constexpr const char* symbol(Operator op){
+  switch(op){
+    case Operator::Add: return "+";
+    case Operator::Sub: return "-";
+    case Operator::Mul: return "*";
+    case Operator::Div: return "/";
+    case Operator::Mod: return "%";
+    case Operator::Less: return "<";
+    case Operator::Greater: return ">";
+    case Operator::LessEq: return "<=";
+    case Operator::GreaterEq: return ">=";
+    case Operator::Equal: return "==";
+    default: return "!=";
+  }
+}
+
+// The operand as toDouble() and toInt() would convert it, with the type known at compile time.
+// intOf() is only called once BigInts have been ruled out.
+template <Datatype type>
+static double doubleOf(const Value& value){
+  if constexpr (type == Datatype::Int){
+    if(auto big = std::get_if<Cow<BigInt>> (&value.data)) return (*big)->toDouble();
+    return std::get<int64_t> (value.data);
+  }
+  else if constexpr (type == Datatype::Double) return std::get<double> (value.data);
+  else if constexpr (type == Datatype::Char) return static_cast<unsigned char> (std::get<char> (value.data));
+  else return std::get<bool> (value.data) ? 1.0 : 0.0;
+}
+
+template <Datatype type>
+static int64_t intOf(const Value& value){
+  if constexpr (type == Datatype::Int) return std::get<int64_t> (value.data);
+  else if constexpr (type == Datatype::Char) return std::get<char> (value.data);
+  else return std::get<bool> (value.data);
+}
+
+template <Operator op, typename T>
+static bool compareAs(const T& left, const T& right){
+  if constexpr (op == Operator::Less) return left < right;
+  else if constexpr (op == Operator::Greater) return left > right;
+  else if constexpr (op == Operator::LessEq) return left <= right;
+  else if constexpr (op == Operator::GreaterEq) return left >= right;
+  else if constexpr (op == Operator::Equal) return left == right;
+  else return left != right;
+}
+
+template <Operator op, typename T>
+static T apply(const T& left, const T& right){
+  if constexpr (op == Operator::Add) return left + right;
+  else if constexpr (op == Operator::Sub) return left - right;
+  else return left * right;
+}
+
+template <Operator op>
+static bool overflows(int64_t left, int64_t right, int64_t& result){
+  if constexpr (op == Operator::Add) return __builtin_add_overflow(left, right, &result);
+  else if constexpr (op == Operator::Sub) return __builtin_sub_overflow(left, right, &result);
+  else return __builtin_mul_overflow(left, right, &result);
+}
+
+template <Operator op, Datatype leftType, Datatype rightType>
+Value Interpreter::binary(Interpreter& self, const Value& left, const Value& right){
+  if constexpr (op > Operator::NotEqual) throw std::runtime_error("Invalid operator");
+  else if constexpr (op == Operator::Add && (leftType == Datatype::String || rightType == Datatype::String)){
+    String result;
+    self.appendString(result, left);
+    self.appendString(result, right);
+    return {Datatype::String, std::move(result)};
+  }
+  else if constexpr (isComparison(op) && leftType == Datatype::String && rightType == Datatype::String){
+    return {Datatype::Bool, compareAs<op>(*std::get<Cow<String>> (left.data), *std::get<Cow<String>> (right.data))};
+  }
+  else if constexpr (op == Operator::Mod){
+    if constexpr (leftType != Datatype::Int || rightType != Datatype::Int) throw std::runtime_error("Operator \"%\" cannot be used to such value type");
+    else{
+      if(isBig(left) || isBig(right)) return normalize(self.toBig(left) % self.toBig(right));
+      auto divisor = std::get<int64_t> (right.data);
+      if(divisor == 0) throw std::runtime_error("Division by zero is not permitted");
+      if(divisor == -1) return {Datatype::Int, int64_t(0)};
+      return {Datatype::Int, std::get<int64_t> (left.data) % divisor};
+    }
+  }
+  else if constexpr (leftType == Datatype::Array || rightType == Datatype::Array) return self.evalArray(op, symbol(op), left, right);
+  else if constexpr (!isNumericType(leftType) || !isNumericType(rightType)){
+    throw std::runtime_error(std::string("Operator \"") + symbol(op) + "\" cannot be used to such value type");
+  }
+  else if constexpr (op == Operator::Div){
+    auto divisor = doubleOf<rightType>(right);
+    if(divisor == 0.0) throw std::runtime_error("Division by zero is not permitted");
+    return {Datatype::Double, doubleOf<leftType>(left) / divisor};
+  }
+  else if constexpr (leftType == Datatype::Double || rightType == Datatype::Double){
+    if constexpr (isComparison(op)) return {Datatype::Bool, compareAs<op>(doubleOf<leftType>(left), doubleOf<rightType>(right))};
+    else return {Datatype::Double, apply<op>(doubleOf<leftType>(left), doubleOf<rightType>(right))};
+  }
+  else{
+    if constexpr (leftType == Datatype::Int || rightType == Datatype::Int){
+      if(isBig(left) || isBig(right)){
+        if constexpr (isComparison(op)) return {Datatype::Bool, compareAs<op>(compare(self.toBig(left), self.toBig(right)), 0)};
+        else return normalize(apply<op>(self.toBig(left), self.toBig(right)));
+      }
+    }
+    auto a = intOf<leftType>(left), b = intOf<rightType>(right);
+    if constexpr (isComparison(op)) return {Datatype::Bool, compareAs<op>(a, b)};
+    else{
+      int64_t result;
+      if(!overflows<op>(a, b, result)) return {Datatype::Int, result};
+      return normalize(apply<op>(BigInt(a), BigInt(b)));
+    }
+  }
+}
+
+constexpr decltype(Interpreter::binaryHandlers) Interpreter::binaryHandlers = []<size_t... index>(std::index_sequence<index...>){
+  return std::array <BinaryHandler, sizeof...(index)>{
+    &binary<static_cast<Operator> (index / (typeCount * typeCount)), static_cast<Datatype> (index / typeCount % typeCount), static_cast<Datatype> (index % typeCount)>...
+  };
+}(std::make_index_sequence<operatorCount * typeCount * typeCount> ());
@@ -0,0 +1,318 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <bit>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+static constexpr size_t minimumArms = 4;
+
+static const Variable* switchVariable(const Expression* expr, int64_t& key){
+  auto binary = dynamic_cast <const Binary*> (expr);
+  if(!binary || binary->op != Operator::Equal) return nullptr;
+  auto variable = dynamic_cast <const Variable*> (binary->left.get());
+  auto literal = dynamic_cast <const exprValue*> (binary->right.get());
+  if(!variable){
+    variable = dynamic_cast <const Variable*> (binary->right.get());
+    literal = dynamic_cast <const exprValue*> (binary->left.get());
+  }
+  if(!variable || !literal) return nullptr;
+  if(auto small = std::get_if <int64_t> (&literal->value.data)) key = *small;
+  else if(literal->value.type == Datatype::Char) key = std::get <char> (literal->value.data);
+  else return nullptr;
+  return variable;
+}
+
+static bool perfectHash(Switch& table, const std::vector <std::pair <int64_t, const Program*>>& arms){
+  for(size_t size = std::bit_ceil(arms.size() * 2); size <= arms.size() * 64; size *= 2){
+    int shift = 64 - std::countr_zero(size);
+    uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    for(int attempt = 0; attempt < 64; attempt++, multiplier = multiplier * 6364136223846793005ull + 1442695040888963407ull){
+      multiplier |= 1;
+      std::vector <std::pair <int64_t, const Program*>> slots(size);
+      bool collision = false;
+      for(const auto& arm : arms){
+        auto& slot = slots[(static_cast <uint64_t> (arm.first) * multiplier) >> shift];
+        if(slot.second){
+          collision = true;
+          break;
+        }
+        slot = arm;
+      }
+      if(collision) continue;
+      table.slots = std::move(slots);
+      table.multiplier = multiplier;
+      table.shift = shift;
+      return true;
+    }
+  }
+  return false;
+}
+
+static std::unique_ptr <Statement> makeSwitch(std::unique_ptr <IfStatement>& chain){
+  std::string name;
+  int slot = -1;
+  std::vector <std::pair <int64_t, const Program*>> arms;
+  std::unordered_set <int64_t> seen;
+  const IfStatement* arm = chain.get();
+  for(; arm && arm->expr; arm = arm->elseStatement.get()){
+    int64_t key;
+    auto variable = switchVariable(arm->expr.get(), key);
+    if(!variable || (!name.empty() && variable->name != name)) return nullptr;
+    name = variable->name;
+    slot = variable->slot;
+    if(seen.insert(key).second) arms.emplace_back(key, arm->Instructions.get());
+  }
+  if(arms.size() < minimumArms) return nullptr;
+  auto table = std::make_unique <Switch> ();
+  table->location = chain->location;
+  table->name = name;
+  table->slot = slot;
+  table->otherwise = arm ? arm->Instructions.get() : nullptr;
+  auto [low, high] = std::minmax_element(arms.begin(), arms.end());
+  auto span = static_cast <uint64_t> (high->first) - static_cast <uint64_t> (low->first);
+  if(span < arms.size() * 2){
+    table->base = low->first;
+    table->dense.assign(span + 1, nullptr);
+    for(const auto& [key, body] : arms) table->dense[static_cast <uint64_t> (key) - static_cast <uint64_t> (table->base)] = body;
+  }
+  else if(!perfectHash(*table, arms)) return nullptr;
+  table->chain = std::move(chain);
+  return table;
+}
+
+static bool isPlainNumber(const Value& value){
+  return std::holds_alternative <int64_t> (value.data) || value.type == Datatype::Double;
+}
+
+static bool isArithmetic(Operator op){
+  return op == Operator::Add || op == Operator::Sub || op == Operator::Mul || op == Operator::Div || op == Operator::Mod;
+}
+
+static bool isComparison(Operator op){
+  return op == Operator::Less || op == Operator::Greater || op == Operator::LessEq || op == Operator::GreaterEq || op == Operator::Equal || op == Operator::NotEqual;
+}
+
+static std::unique_ptr <Statement> fuseUpdate(std::unique_ptr <Statement>& stmt){
+  auto definition = static_cast <Definition*> (stmt.get());
+  auto binary = dynamic_cast <const Binary*> (definition->value.get());
+  if(!binary || !isArithmetic(binary->op)) return nullptr;
+  auto variable = dynamic_cast <const Variable*> (binary->left.get());
+  auto literal = dynamic_cast <const exprValue*> (binary->right.get());
+  if(!variable || !literal || variable->name != definition->name || !isPlainNumber(literal->value)) return nullptr;
+  auto update = std::make_unique <Update> ();
+  update->location = definition->location;
+  update->name = definition->name;
+  update->slot = definition->slot;
+  update->op = binary->op;
+  update->operand = literal->value;
+  update->original.reset(static_cast <Definition*> (stmt.release()));
+  return update;
+}
+
+static void fuseCondition(std::unique_ptr <Expression>& expr){
+  auto binary = dynamic_cast <const Binary*> (expr.get());
+  if(!binary || !isComparison(binary->op)) return;
+  auto variable = dynamic_cast <const Variable*> (binary->left.get());
+  if(!variable) return;
+  auto comparison = std::make_unique <Comparison> ();
+  if(auto literal = dynamic_cast <const exprValue*> (binary->right.get()); literal && isPlainNumber(literal->value)){
+    comparison->literal = literal->value;
+  }
+  else if(auto other = dynamic_cast <const Variable*> (binary->right.get())){
+    comparison->other = std::make_unique <Variable> (*other);
+  }
+  else return;
+  comparison->location = binary->location;
+  comparison->op = binary->op;
+  comparison->name = variable->name;
+  comparison->slot = variable->slot;
+  comparison->original = std::move(expr);
+  expr = std::move(comparison);
+}
+
+static std::unique_ptr <Statement> renderOutput(const Output& stmt){
+  auto literal = dynamic_cast <const exprValue*> (stmt.output.get());
+  if(!literal) return nullptr;
+  std::ostringstream text;
+  auto& data = literal->value.data;
+  if(auto a = std::get_if <int64_t> (&data)) text << *a;
+  else if(auto a = std::get_if <double> (&data)) text << *a;
+  else if(auto a = std::get_if <char> (&data)) text << *a;
+  else if(auto a = std::get_if <bool> (&data)) text << *a;
+  else if(auto a = std::get_if <Cow <String>> (&data)) text << **a;
+  else return nullptr;
+  auto rendered = std::make_unique <OutputText> ();
+  rendered->location = stmt.location;
+  rendered->text = text.str();
+  return rendered;
+}
+
+static void optimizeStatement(std::unique_ptr <Statement>& stmt){
+  if(auto a = dynamic_cast <IfStatement*> (stmt.get())){
+    for(auto arm = a; arm; arm = arm->elseStatement.get()) optimize(*arm->Instructions);
+    std::unique_ptr <IfStatement> chain(static_cast <IfStatement*> (stmt.release()));
+    auto table = makeSwitch(chain);
+    if(table) stmt = std::move(table);
+    else stmt = std::move(chain);
+  }
+  else if(auto a = dynamic_cast <While*> (stmt.get())){
+    optimize(*a->Instructions);
+    fuseCondition(a->expr);
+  }
+  else if(dynamic_cast <Definition*> (stmt.get())){
+    if(auto update = fuseUpdate(stmt)) stmt = std::move(update);
+  }
+  else if(auto a = dynamic_cast <Output*> (stmt.get())){
+    if(auto rendered = renderOutput(*a)) stmt = std::move(rendered);
+  }
+  else if(auto a = dynamic_cast <For*> (stmt.get())) optimize(*a->Instructions);
+  else if(auto a = dynamic_cast <Function*> (stmt.get())) optimize(*a->body);
+}
+
+void optimize(Program& program){
+  for(auto& stmt : program.statements) optimizeStatement(stmt);
+}
+
+void optimize(std::unique_ptr <Statement>& stmt){
+  optimizeStatement(stmt);
+}
+
+static bool collectNames(const Program& program, std::unordered_set <std::string>& names);
+
+// Adds every variable the expression mentions; false when it cannot tell, so the caller must assume it uses any name.
+static bool collectNames(const Expression* expr, std::unordered_set <std::string>& names){
+  if(!expr || dynamic_cast <const exprValue*> (expr)) return true;
+  if(auto a = dynamic_cast <const Variable*> (expr)){
+    names.insert(a->name);
+    return true;
+  }
+  if(auto a = dynamic_cast <const Binary*> (expr)) return collectNames(a->left.get(), names) && collectNames(a->right.get(), names);
+  if(auto a = dynamic_cast <const Cast*> (expr)) return collectNames(a->expr.get(), names);
+  if(auto a = dynamic_cast <const Index*> (expr)) return collectNames(a->base.get(), names) && collectNames(a->index.get(), names);
+  if(auto a = dynamic_cast <const Comparison*> (expr)){
+    names.insert(a->name);
+    return collectNames(a->other.get(), names) && collectNames(a->original.get(), names);
+  }
+  const std::vector <std::unique_ptr <Expression>>* lists[2] = {};
+  if(auto a = dynamic_cast <const ArrayLiteral*> (expr)) lists[0] = &a->elements;
+  else if(auto a = dynamic_cast <const MapLiteral*> (expr)){
+    lists[0] = &a->keys;
+    lists[1] = &a->values;
+  }
+  else if(auto a = dynamic_cast <const Call*> (expr)) lists[0] = &a->arguments;
+  else return false;
+  for(auto list : lists){
+    if(!list) continue;
+    for(const auto& element : *list){
+      if(!collectNames(element.get(), names)) return false;
+    }
+  }
+  return true;
+}
+
+static bool collectNames(const Statement* stmt, std::unordered_set <std::string>& names){
+  if(!stmt || dynamic_cast <const OutputText*> (stmt)) return true;
+  // A function body only sees its own locals.
+  if(dynamic_cast <const Function*> (stmt)) return true;
+  if(auto a = dynamic_cast <const Input*> (stmt)) return collectNames(a->input.get(), names);
+  if(auto a = dynamic_cast <const Output*> (stmt)) return collectNames(a->output.get(), names);
+  if(auto a = dynamic_cast <const Return*> (stmt)) return collectNames(a->value.get(), names);
+  if(auto a = dynamic_cast <const CallStatement*> (stmt)) return collectNames(a->call.get(), names);
+  if(auto a = dynamic_cast <const Declaration*> (stmt)){
+    names.insert(a->name);
+    return true;
+  }
+  if(auto a = dynamic_cast <const Definition*> (stmt)){
+    names.insert(a->name);
+    return collectNames(a->value.get(), names);
+  }
+  if(auto a = dynamic_cast <const Update*> (stmt)){
+    names.insert(a->name);
+    return collectNames(a->original.get(), names);
+  }
+  if(auto a = dynamic_cast <const ElementDefinition*> (stmt)){
+    names.insert(a->name);
+    for(const auto& index : a->index){
+      if(!collectNames(index.get(), names)) return false;
+    }
+    return collectNames(a->value.get(), names);
+  }
+  if(auto a = dynamic_cast <const IfStatement*> (stmt)){
+    for(auto arm = a; arm; arm = arm->elseStatement.get()){
+      if(!collectNames(arm->expr.get(), names) || !collectNames(*arm->Instructions, names)) return false;
+    }
+    return true;
+  }
+  if(auto a = dynamic_cast <const Switch*> (stmt)){
+    names.insert(a->name);
+    return collectNames(a->chain.get(), names);
+  }
+  if(auto a = dynamic_cast <const While*> (stmt)) return collectNames(a->expr.get(), names) && collectNames(*a->Instructions, names);
+  if(auto a = dynamic_cast <const For*> (stmt)){
+    return collectNames(a->Initialvalue.get(), names) && collectNames(a->step.get(), names) && collectNames(a->Finalvalue.get(), names) && collectNames(*a->Instructions, names);
+  }
+  return false;
+}
+
+static bool collectNames(const Program& program, std::unordered_set <std::string>& names){
+  // A lazy block that has not run yet may mention anything.
+  if(auto lazy = dynamic_cast <const LazyProgram*> (&program); lazy && lazy->parse) return false;
+  for(const auto& stmt : program.statements){
+    if(!collectNames(stmt.get(), names)) return false;
+  }
+  return true;
+}
+
+// Adds the variable a statement directly in a block may create in that block's scope.
+static void collectDeclared(const Statement* stmt, std::unordered_set <std::string>& names){
+  if(auto a = dynamic_cast <const Declaration*> (stmt)) names.insert(a->name);
+  else if(auto a = dynamic_cast <const Definition*> (stmt)) names.insert(a->name);
+  else if(auto a = dynamic_cast <const Update*> (stmt)) names.insert(a->name);
+  else if(auto a = dynamic_cast <const Input*> (stmt)) collectNames(a->input.get(), names);
+}
+
+// Only names the block itself may create are released, and the interpreter only drops them from the scope of the
+// block running the Release and never drops bound names, so an enclosing block's, a caller's, a parallel for
+// parent's or the host's variable is never touched. A block's own variables cannot be seen once it ends, and
+// loop bodies start every iteration with a fresh scope.
+void releaseDeadVariables(Program& program){
+  auto& statements = program.statements;
+  std::unordered_map <std::string, size_t> last;
+  std::unordered_set <std::string> declared;
+  size_t opaque = 0;
+  for(size_t i = 0; i < statements.size(); i++){
+    std::unordered_set <std::string> names;
+    if(!collectNames(statements[i].get(), names)) opaque = i;
+    for(const auto& name : names) last[name] = i;
+    collectDeclared(statements[i].get(), declared);
+  }
+  std::vector <std::vector <std::string>> dead(statements.size());
+  for(const auto& [name, index] : last){
+    if(!declared.count(name)) continue;
+    auto after = std::max(index, opaque);
+    if(after + 1 < statements.size()) dead[after].push_back(name);
+  }
+  std::vector <std::unique_ptr <Statement>> rewritten;
+  rewritten.reserve(statements.size() + last.size());
+  for(size_t i = 0; i < statements.size(); i++){
+    rewritten.push_back(std::move(statements[i]));
+    if(dead[i].empty()) continue;
+    auto release = std::make_unique <Release> ();
+    release->location = rewritten.back()->location;
+    std::sort(dead[i].begin(), dead[i].end());
+    release->names = std::move(dead[i]);
+    rewritten.push_back(std::move(release));
+  }
+  statements = std::move(rewritten);
+  for(auto& stmt : statements){
+    if(auto a = dynamic_cast <IfStatement*> (stmt.get())){
+      for(auto arm = a; arm; arm = arm->elseStatement.get()) releaseDeadVariables(*arm->Instructions);
+    }
+    else if(auto a = dynamic_cast <Switch*> (stmt.get())){
+      for(auto arm = a->chain.get(); arm; arm = arm->elseStatement.get()) releaseDeadVariables(*arm->Instructions);
+    }
+    else if(auto a = dynamic_cast <While*> (stmt.get())) releaseDeadVariables(*a->Instructions);
+    else if(auto a = dynamic_cast <For*> (stmt.get())) releaseDeadVariables(*a->Instructions);
+  }
+}
@@ -1,8 +1,17 @@
 #include "parser.h"
+#include "bigint.h"
+#include "optimizer.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <utility>
 const Token& Parser::peek() const {
     return tokens[line][pos];
 }
 
+const Token& Parser::peekNext() const {
+    return tokens[line][pos + 1 < tokens[line].size() ? pos + 1 : pos];
+}
+
 Token& Parser::advance(){
     if(isEnd()) throw std::invalid_argument("Unexepected ending at line: " + std::to_string(peek().lineID) + "; column: " + std::to_string(peek().columnID));
     return tokens[line][pos++];
@@ -11,6 +20,29 @@ Token& Parser::advance(){
 
 Parser::Parser(std::vector <std::vector <Token>>& T) : tokens(T) {}
 
+Parser::Parser(std::shared_ptr <std::vector <std::vector <Token>>> T, bool lazy) : tokens(*T), shared(T), lazy(lazy) {}
+
+Parser::Parser(std::vector <std::vector <Token>>& T, BoundedQueue <std::vector <std::vector <Token>>>& lines) : tokens(T), source(&lines) {}
+
+bool Parser::available(size_t index, bool rethrow){
+  std::vector <std::vector <std::vector <Token>>> batches;
+  while(source && index >= tokens.size()){
+    try{
+      if(!source->pop(batches)) source = nullptr;
+    }
+    catch(...){
+      failure = std::current_exception();
+      source = nullptr;
+    }
+    for(auto& batch : batches){
+      for(auto& tokenLine : batch) tokens.push_back(std::move(tokenLine));
+    }
+    batches.clear();
+  }
+  if(index >= tokens.size() && failure && rethrow) std::rethrow_exception(failure);
+  return index < tokens.size();
+}
+
 bool Parser::isEnd(){
     return peek().type == TokenType::End;
 }
@@ -35,6 +67,7 @@ bool Parser::eatEnd(){
   if(Check(TokenType::End)){
   line++;
   pos = 0;
+  available(line);
   return true;
   }
   return false;
@@ -60,11 +93,18 @@ Datatype Parser::getDatatype(const Keyword& keyword){
   }
 }
 
-std::variant <int64_t, char, std::string, double, bool, std::vector <Value>> Parser::getData(){
-  if(Check(TokenType::Number)) return std::stoi(peek().lexeme);
+ValueData Parser::getData(){
+  if(Check(TokenType::Number)){
+    try{
+      return std::stoll(peek().lexeme);
+    }
+    catch(const std::out_of_range&){
+      return Cow<BigInt> (BigInt::parse(peek().lexeme));
+    }
+  }
   if(Check(TokenType::Double)) return std::stod(peek().lexeme);
   if(Check(TokenType::Symbol)) return peek().lexeme[0];
-  if(Check(TokenType::String)) return peek().lexeme;
+  if(Check(TokenType::String)) return String(peek().lexeme.begin(), peek().lexeme.end());
   if(Check(TokenType::Boolean)){
     if(peek().lexeme == "true") return true;
     if (peek().lexeme == "false") return false;
@@ -73,9 +113,10 @@ std::variant <int64_t, char, std::string, double, bool, std::vector <Value>> Par
 
 std::unique_ptr <Program> Parser::MakeBody(){
  auto body = std::make_unique <Program> ();
+ scopes.emplace_back();
    eatEnd();
   while(true){
-    if(line>=tokens.size()) {
+    if(!available(line)) {
       line --;
       pos = tokens[line].size()-1;
       SyntaxErr("Expected \"}\"");
@@ -86,14 +127,79 @@ std::unique_ptr <Program> Parser::MakeBody(){
     else if (!eatEnd() && pos!=0) SyntaxErr("End of the line is expected");
   }
   advance();
+  scopes.pop_back();
   if(isEnd()){
-   if(line == tokens.size()-1) return body; 
+   if(!available(line + 1, false)) return body; 
    line++;
    pos=0;
   }
   return body;
 }
 
+std::unique_ptr <Program> Parser::DeferBody(){
+  if(!lazy || function) return MakeBody();
+  size_t startLine = line;
+  size_t startPos = pos;
+  size_t depth = 1;
+  while(true){
+    if(!available(line)){
+      line--;
+      pos = tokens[line].size()-1;
+      SyntaxErr("Expected \"}\"");
+    }
+    const auto& token = tokens[line][pos];
+    if(token.type == TokenType::End){
+      line++;
+      pos = 0;
+      continue;
+    }
+    if(token.type == TokenType::Keyword && token.keyword == Keyword::Parallel){
+      line = startLine;
+      pos = startPos;
+      return MakeBody();
+    }
+    if(token.type == TokenType::Separator && token.lexeme == "{") depth++;
+    else if(token.type == TokenType::Separator && token.lexeme == "}" && --depth == 0) break;
+    pos++;
+  }
+  auto body = std::make_unique <LazyProgram> ();
+  body->parse = [tokens = shared, startLine, startPos](Program& target){
+    Parser parser(tokens, true);
+    parser.line = startLine;
+    parser.pos = startPos;
+    auto parsed = parser.MakeBody();
+    optimize(*parsed);
+    releaseDeadVariables(*parsed);
+    target.statements = std::move(parsed->statements);
+  };
+  deferred.emplace_back(startLine, startPos);
+  advance();
+  if(isEnd()){
+   if(!available(line + 1, false)) return body;
+   line++;
+   pos=0;
+  }
+  return body;
+}
+
+void Parser::Validate(){
+  std::vector <std::exception_ptr> errors(deferred.size());
+  ThreadPool::shared().run(deferred.size(), [&](size_t i){
+    try{
+      Parser parser(shared, false);
+      parser.line = deferred[i].first;
+      parser.pos = deferred[i].second;
+      parser.MakeBody();
+    }
+    catch(...){
+      errors[i] = std::current_exception();
+    }
+  });
+  for(const auto& error : errors){
+    if(error) std::rethrow_exception(error);
+  }
+}
+
 Operator Parser::GetOperator(const std::string& op){
   if(op == ">") return Operator::Greater;
   else if(op == "<") return Operator::Less;
@@ -120,12 +226,45 @@ std::unique_ptr <Expression> Parser::SingleParse(){
         expr->location.column = advance().columnID;
         return expr;
     }
+    else if(isCall()) return ParsePostfix(ParseCall());
     else if(Check(TokenType::Identifier)){
         auto expr = std::make_unique <Variable> ();
         expr->name = peek().lexeme;
         expr->location.line = peek().lineID;
         expr->location.column = advance().columnID;
-        return expr;
+        return ParsePostfix(std::move(expr));
+    }
+    else if(Check("[")){
+        auto expr = std::make_unique <ArrayLiteral> ();
+        expr->location.line = peek().lineID;
+        expr->location.column = advance().columnID;
+        if(!Check("]")){
+          expr->elements.push_back(MakeExpression());
+          while(Check(",")){
+            advance();
+            expr->elements.push_back(MakeExpression());
+          }
+        }
+        if(Check("]")) advance();
+        else SyntaxErr(CLOSESQUAREBRACKET);
+        return ParsePostfix(std::move(expr));
+    }
+    else if(Check("{")){
+        auto expr = std::make_unique <MapLiteral> ();
+        expr->location.line = peek().lineID;
+        expr->location.column = advance().columnID;
+        while(!Check("}")){
+          if(!expr->keys.empty()){
+            if(Check(",")) advance();
+            else SyntaxErr("Expected \"}\"");
+          }
+          expr->keys.push_back(MakeExpression());
+          if(Check(":")) advance();
+          else SyntaxErr("Expected \":\"");
+          expr->values.push_back(MakeExpression());
+        }
+        advance();
+        return ParsePostfix(std::move(expr));
     }
     else if(Check(TokenType::Keyword)){
         auto expr = std::make_unique <Cast> ();
@@ -145,12 +284,60 @@ std::unique_ptr <Expression> Parser::SingleParse(){
       auto expr = MakeExpression();
       if(Check(")")) advance();
       else SyntaxErr(CLOSEBRACKET);
-      return expr;
+      return ParsePostfix(std::move(expr));
     }
     SyntaxErr("Invalid component of the expression");
     return nullptr;
 }
 
+std::unique_ptr <Expression> Parser::ParsePostfix(std::unique_ptr <Expression> expr){
+  while(Check("[")){
+    auto index = std::make_unique <Index> ();
+    index->location.line = peek().lineID;
+    index->location.column = advance().columnID;
+    index->base = std::move(expr);
+    index->index = MakeExpression();
+    if(Check("]")) advance();
+    else SyntaxErr(CLOSESQUAREBRACKET);
+    expr = std::move(index);
+  }
+  return expr;
+}
+
+bool Parser::isCall(){
+  if(!Check(TokenType::Identifier) || peekNext().lexeme != "(") return false;
+  const auto& current = tokens[line];
+  // A line cut short after "(" is left to ParseCall() to report.
+  if(pos + 3 >= current.size()) return true;
+  return !(current[pos + 2].type == TokenType::Identifier && current[pos + 3].lexeme == "=");
+}
+
+std::unique_ptr <Expression> Parser::ParseCall(){
+  auto expr = std::make_unique <Call> ();
+  expr->name = peek().lexeme;
+  expr->location.line = peek().lineID;
+  expr->location.column = advance().columnID;
+  advance();
+  if(!Check(")")){
+    expr->arguments.push_back(MakeExpression());
+    while(Check(",")){
+      advance();
+      expr->arguments.push_back(MakeExpression());
+    }
+  }
+  if(Check(")")) advance();
+  else SyntaxErr(CLOSEBRACKET);
+  return expr;
+}
+
+std::unique_ptr <Statement> Parser::ParseCallStatement(){
+  auto stmt = std::make_unique <CallStatement> ();
+  stmt->location.line = peek().lineID;
+  stmt->location.column = peek().columnID;
+  stmt->call.reset(static_cast <Call*> (ParseCall().release()));
+  return stmt;
+}
+
 std::unique_ptr <Expression> Parser::MakeExpression(){
   auto expr = ParseMidTerm();
 
@@ -205,6 +392,10 @@ std::unique_ptr <Statement> Parser::ParseInput(){
     if(Check("(")) advance();
     else SyntaxErr(OPENBRACKET);
     stmt->input = MakeExpression();
+    if(auto a = dynamic_cast <Variable*> (stmt->input.get())) declare(a->name);
+    else if(auto a = dynamic_cast <Cast*> (stmt->input.get())){
+      if(auto b = dynamic_cast <Variable*> (a->expr.get())) declare(b->name);
+    }
     if(Check(")")) advance();
     else SyntaxErr(CLOSEBRACKET);
     return stmt;
@@ -227,9 +418,25 @@ std::unique_ptr <Statement> Parser::ParseDefinition(){
         if (Check("=")) stmt-> location.line = advance().lineID;
         else SyntaxErr("Expected \"=\"");
         stmt->value = MakeExpression();
+        declare(stmt->name);
         return stmt;
 }
 
+std::unique_ptr <Statement> Parser::ParseElementDefinition(){
+  auto stmt = std::make_unique <ElementDefinition> ();
+  stmt->name = advance().lexeme;
+  while(Check("[")){
+    advance();
+    stmt->index.push_back(MakeExpression());
+    if(Check("]")) advance();
+    else SyntaxErr(CLOSESQUAREBRACKET);
+  }
+  if (Check("=")) stmt->location.line = advance().lineID;
+  else SyntaxErr("Expected \"=\"");
+  stmt->value = MakeExpression();
+  return stmt;
+}
+
 std::unique_ptr <Statement> Parser::ParseIfStatement(){
   auto stmt = std::make_unique<IfStatement> ();
   stmt -> location.line = advance().lineID;
@@ -241,7 +448,7 @@ std::unique_ptr <Statement> Parser::ParseIfStatement(){
   eatEnd();
   if (Check("{")) advance();
   else SyntaxErr(CURLYBRACKET);
-  stmt->Instructions = MakeBody();
+  stmt->Instructions = DeferBody();
   if(Check(Keyword::Else)){
     stmt-> elseStatement = std::make_unique <IfStatement> ();
     stmt-> location.line = advance().lineID; 
@@ -249,7 +456,7 @@ std::unique_ptr <Statement> Parser::ParseIfStatement(){
     if (Check("{")) {
       advance();
       stmt->elseStatement->expr = nullptr;
-      stmt->elseStatement->Instructions = MakeBody();
+      stmt->elseStatement->Instructions = DeferBody();
     }
     else if(Check(Keyword::If)){
       stmt->elseStatement.reset(static_cast <IfStatement*>(ParseIfStatement().release()));
@@ -270,7 +477,7 @@ std::unique_ptr <Statement> Parser::ParseWhile(){
   eatEnd();
   if(Check("{")) advance();
   else SyntaxErr(CURLYBRACKET);
-  stmt->Instructions = MakeBody();
+  stmt->Instructions = DeferBody();
   return stmt;
 }
 
@@ -280,9 +487,11 @@ std::unique_ptr <Statement> Parser::ParseFor(){
   if(Check("(")) advance();
   else SyntaxErr(OPENBRACKET);
   stmt->Initialvalue->value = nullptr;
+  scopes.emplace_back();
   if(Check(TokenType::Identifier)) {
     stmt->Initialvalue->location.line = peek().lineID;
     stmt->Initialvalue->name = advance().lexeme;
+    declare(stmt->Initialvalue->name);
   }
   else SyntaxErr("Variable (iterator) is expected");
   if(Check("=")){
@@ -309,24 +518,234 @@ std::unique_ptr <Statement> Parser::ParseFor(){
   eatEnd();
   if(Check("{")) advance();
   else SyntaxErr(CURLYBRACKET);
-  stmt->Instructions = MakeBody();
+  stmt->Instructions = DeferBody();
+  scopes.pop_back();
   return stmt;
 }
 
+void Parser::declare(const std::string& name){
+  scopes.back().insert(name);
+}
+
+bool Parser::isDeclared(const std::string& name) const{
+  for(const auto& scope : scopes){
+    if(scope.count(name)) return true;
+  }
+  return false;
+}
+
+void Parser::checkParallelBody(const Program& body, const For& loop){
+  auto reject = [](const std::string& err, const Location& location){
+    if(location.column == 0) throw std::invalid_argument(err + " at line: " + std::to_string(location.line));
+    throw std::invalid_argument(err + " at line: " + std::to_string(location.line) + "; column: " + std::to_string(location.column));
+  };
+  auto checkWrite = [&](const std::string& name, const Location& location){
+    if(name != loop.Initialvalue->name && isDeclared(name)) reject("Variable \"" + name + "\" defined outside of the parallel for cannot be changed inside it", location);
+  };
+  for(const auto& stmt : body.statements){
+    if(auto a = dynamic_cast <const Definition*> (stmt.get())) checkWrite(a->name, a->location);
+    else if(auto a = dynamic_cast <const ElementDefinition*> (stmt.get())) checkWrite(a->name, a->location);
+    else if(auto a = dynamic_cast <const CallStatement*> (stmt.get())){
+      auto target = a->call->arguments.empty() ? nullptr : dynamic_cast <const Variable*> (a->call->arguments[0].get());
+      if(a->call->name == "erase" && target) checkWrite(target->name, a->location);
+    }
+    else if(dynamic_cast <const Input*> (stmt.get())) reject("Input is not permitted inside the parallel for", stmt->location);
+    else if(auto a = dynamic_cast <const While*> (stmt.get())) checkParallelBody(*a->Instructions, loop);
+    else if(auto a = dynamic_cast <const For*> (stmt.get())){
+      checkWrite(a->Initialvalue->name, a->location);
+      if(a->step) checkWrite(a->step->name, a->location);
+      checkParallelBody(*a->Instructions, loop);
+    }
+    else if(auto a = dynamic_cast <const IfStatement*> (stmt.get())){
+      for(auto branch = a; branch; branch = branch->elseStatement.get()) checkParallelBody(*branch->Instructions, loop);
+    }
+  }
+}
+
+std::unique_ptr <Statement> Parser::ParseParallelFor(){
+  if(function) SyntaxErr("The parallel for is not permitted inside a function");
+  advance();
+  if(!Check(Keyword::For)) SyntaxErr("Expected \"for\" after \"parallel\"");
+  auto eager = std::exchange(lazy, false);
+  auto stmt = ParseFor();
+  lazy = eager;
+  auto loop = static_cast <For*> (stmt.get());
+  loop->parallel = true;
+  checkParallelBody(*loop->Instructions, *loop);
+  return stmt;
+}
+
+[[noreturn]] static void rejectImpure(const std::string& err, const Location& location){
+  throw std::invalid_argument(err + " inside a pure function at line: " + std::to_string(location.line));
+}
+
+std::unique_ptr <Statement> Parser::ParseFunction(){
+  auto stmt = std::make_unique <Function> ();
+  stmt->location.line = peek().lineID;
+  if(function || scopes.size() > 1) SyntaxErr("Functions can only be defined at the top level");
+  if(Check(Keyword::Pure)){
+    advance();
+    stmt->pure = true;
+    if(!Check(Keyword::Func)) SyntaxErr("Expected \"func\" after \"pure\"");
+  }
+  advance();
+  if(!Check(TokenType::Identifier)) SyntaxErr("Function name is expected");
+  stmt->name = advance().lexeme;
+  if(Check("(")) advance();
+  else SyntaxErr(OPENBRACKET);
+  while(!Check(")")){
+    if(!Check(TokenType::Identifier)) SyntaxErr("Parameter name is expected");
+    if(std::find(stmt->parameters.begin(), stmt->parameters.end(), peek().lexeme) != stmt->parameters.end()) SyntaxErr("Parameter \"" + peek().lexeme + "\" is repeated");
+    stmt->parameters.push_back(advance().lexeme);
+    if(Check(",")) advance();
+    else if(!Check(")")) SyntaxErr(CLOSEBRACKET);
+  }
+  advance();
+  eatEnd();
+  if(Check("{")) advance();
+  else SyntaxErr(CURLYBRACKET);
+  function = stmt.get();
+  auto outer = std::exchange(scopes, {{}});
+  stmt->body = MakeBody();
+  scopes = std::move(outer);
+  function = nullptr;
+  slots.clear();
+  for(const auto& parameter : stmt->parameters) slotOf(parameter);
+  resolveSlots(*stmt->body, *stmt);
+  stmt->slots = slots.size();
+  if(stmt->pure) purity.try_emplace(stmt->name, true);
+  else{
+    purity[stmt->name] = false;
+    if(auto found = pureCalls.find(stmt->name); found != pureCalls.end()) rejectImpure("Impure function \"" + stmt->name + "\" is not permitted", found->second);
+  }
+  return stmt;
+}
+
+std::unique_ptr <Statement> Parser::ParseReturn(){
+  if(!function) SyntaxErr("Return is not permitted outside a function");
+  auto stmt = std::make_unique <Return> ();
+  stmt->location.line = peek().lineID;
+  stmt->location.column = advance().columnID;
+  if(!isEnd() && !Check("}")) stmt->value = MakeExpression();
+  return stmt;
+}
+
+int Parser::slotOf(const std::string& name){
+  return slots.try_emplace(name, static_cast <int> (slots.size())).first->second;
+}
+
+void Parser::resolveSlots(Program& body, const Function& owner){
+  for(auto& stmt : body.statements){
+    if(auto a = dynamic_cast <Output*> (stmt.get())){
+      if(owner.pure) rejectImpure("Output is not permitted", a->location);
+      resolveSlots(*a->output, owner);
+    }
+    else if(auto a = dynamic_cast <Input*> (stmt.get())){
+      if(owner.pure) rejectImpure("Input is not permitted", a->location);
+      resolveSlots(*a->input, owner);
+    }
+    else if(auto a = dynamic_cast <Definition*> (stmt.get())){
+      a->slot = slotOf(a->name);
+      resolveSlots(*a->value, owner);
+    }
+    else if(auto a = dynamic_cast <ElementDefinition*> (stmt.get())){
+      a->slot = slotOf(a->name);
+      for(auto& index : a->index) resolveSlots(*index, owner);
+      resolveSlots(*a->value, owner);
+    }
+    else if(auto a = dynamic_cast <CallStatement*> (stmt.get())) resolveSlots(*a->call, owner);
+    else if(auto a = dynamic_cast <IfStatement*> (stmt.get())){
+      for(auto branch = a; branch; branch = branch->elseStatement.get()){
+        if(branch->expr) resolveSlots(*branch->expr, owner);
+        resolveSlots(*branch->Instructions, owner);
+      }
+    }
+    else if(auto a = dynamic_cast <While*> (stmt.get())){
+      resolveSlots(*a->expr, owner);
+      resolveSlots(*a->Instructions, owner);
+    }
+    else if(auto a = dynamic_cast <For*> (stmt.get())){
+      a->Initialvalue->slot = slotOf(a->Initialvalue->name);
+      if(a->Initialvalue->value) resolveSlots(*a->Initialvalue->value, owner);
+      if(a->step){
+        a->step->slot = slotOf(a->step->name);
+        resolveSlots(*a->step->value, owner);
+      }
+      resolveSlots(*a->Finalvalue, owner);
+      resolveSlots(*a->Instructions, owner);
+    }
+    else if(auto a = dynamic_cast <Return*> (stmt.get())){
+      if(a->value) resolveSlots(*a->value, owner);
+    }
+  }
+}
+
+void Parser::resolveSlots(Expression& expr, const Function& owner){
+  if(auto a = dynamic_cast <Variable*> (&expr)) a->slot = slotOf(a->name);
+  else if(auto a = dynamic_cast <Binary*> (&expr)){
+    resolveSlots(*a->left, owner);
+    resolveSlots(*a->right, owner);
+  }
+  else if(auto a = dynamic_cast <Cast*> (&expr)) resolveSlots(*a->expr, owner);
+  else if(auto a = dynamic_cast <ArrayLiteral*> (&expr)){
+    for(auto& element : a->elements) resolveSlots(*element, owner);
+  }
+  else if(auto a = dynamic_cast <MapLiteral*> (&expr)){
+    for(auto& key : a->keys) resolveSlots(*key, owner);
+    for(auto& value : a->values) resolveSlots(*value, owner);
+  }
+  else if(auto a = dynamic_cast <Index*> (&expr)){
+    resolveSlots(*a->base, owner);
+    resolveSlots(*a->index, owner);
+  }
+  else if(auto a = dynamic_cast <Call*> (&expr)){
+    if(owner.pure) checkPureCall(*a, owner);
+    for(auto& argument : a->arguments) resolveSlots(*argument, owner);
+  }
+}
+
+// Results of pure functions are memoized, so their calls may not reach I/O, directly or through another function.
+// A call to a function not defined yet is checked when its definition is parsed.
+void Parser::checkPureCall(const Call& call, const Function& owner){
+  static const std::unordered_set <std::string> io{"open_input", "open_output", "close_input", "close_output", "readline", "eof", "read_file"};
+  if(io.count(call.name)) rejectImpure("Function \"" + call.name + "\" is not permitted", call.location);
+  if(call.name == owner.name) return;
+  auto found = purity.find(call.name);
+  if(found == purity.end()) pureCalls.try_emplace(call.name, call.location);
+  else if(!found->second) rejectImpure("Impure function \"" + call.name + "\" is not permitted", call.location);
+}
+
 std::unique_ptr <Statement> Parser::MakeStatement(){
     if(Check(Keyword::Out)) return ParseOutput();
     else if (Check(Keyword::In)) return ParseInput();
+    else if (Check(TokenType::Identifier) && peekNext().lexeme == "[") return ParseElementDefinition();
+    else if (isCall()) return ParseCallStatement();
     else if (Check(TokenType::Identifier)) return ParseDefinition();
     else if(Check(Keyword::If)) return ParseIfStatement();
     else if(Check(Keyword::While)) return ParseWhile();
     else if(Check(Keyword::For)) return ParseFor();
+    else if(Check(Keyword::Parallel)) return ParseParallelFor();
+    else if(Check(Keyword::Func) || Check(Keyword::Pure)) return ParseFunction();
+    else if(Check(Keyword::Return)) return ParseReturn();
     SyntaxErr("Cannot match the Syntax");
     return nullptr; 
 }
 
 void Parser::Parse(Program& program){
-    while(line<tokens.size()){
-         program.statements.push_back(MakeStatement());
-         if(!eatEnd() && pos!=0) SyntaxErr("End of the line is expected");
+    Parse([&](std::unique_ptr <Statement> stmt){
+      program.statements.push_back(std::move(stmt));
+    });
+}
+
+void Parser::Parse(const std::function <void(std::unique_ptr <Statement>)>& emit){
+    while(available(line)){
+         auto stmt = MakeStatement();
+         bool end = Check(TokenType::End);
+         if(!end && pos!=0) SyntaxErr("End of the line is expected");
+         emit(std::move(stmt));
+         if(end) eatEnd();
+         if(source){
+           for(; released < line; released++) std::vector <Token>().swap(tokens[released]);
+         }
     }
 }
@@ -0,0 +1,207 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+size_t InputChannel::wordEnd(){
+  while(pos < buffer.size() && std::isspace(static_cast <unsigned char> (buffer[pos]))) pos++;
+  size_t end = pos;
+  while(end < buffer.size() && !std::isspace(static_cast <unsigned char> (buffer[end]))) end++;
+  return end;
+}
+
+void InputChannel::write(std::string_view text){
+  std::function <void()> callback;
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    if(pos > buffer.size() / 2){
+      buffer.erase(0, pos);
+      pos = 0;
+    }
+    buffer.append(text);
+    callback = notify;
+  }
+  arrived.notify_all();
+  if(callback) callback();
+}
+
+void InputChannel::close(){
+  std::function <void()> callback;
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    closed = true;
+    callback = notify;
+  }
+  arrived.notify_all();
+  if(callback) callback();
+}
+
+void InputChannel::abandon(){
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    abandoned = true;
+  }
+  arrived.notify_all();
+}
+
+bool InputChannel::ready(){
+  std::lock_guard <std::mutex> guard(lock);
+  return closed || wordEnd() < buffer.size();
+}
+
+void InputChannel::read(String& word){
+  std::unique_lock <std::mutex> guard(lock);
+  size_t end;
+  arrived.wait(guard, [&]{ return abandoned || closed || (end = wordEnd()) < buffer.size(); });
+  if(abandoned) throw std::runtime_error("The input was abandoned");
+  end = wordEnd();
+  word.assign(buffer.begin() + pos, buffer.begin() + end);
+  pos = end;
+}
+
+void InputChannel::onData(std::function <void()> callback){
+  std::lock_guard <std::mutex> guard(lock);
+  notify = std::move(callback);
+}
+
+Task::~Task(){
+  auto previous = std::exchange(MemoryTracker::active(), &tracker);
+  interpreter.reset();
+  MemoryTracker::active() = previous;
+}
+
+Scheduler::Scheduler(size_t workers, size_t slice) : slice(slice == 0 ? 1 : slice){
+  if(workers == 0) workers = std::thread::hardware_concurrency();
+  if(workers == 0) workers = 1;
+  this->workers = workers;
+  std::lock_guard <std::mutex> guard(lock);
+  for(; active < workers; active++) threads.emplace_back(&Scheduler::workerLoop, this);
+}
+
+Scheduler::~Scheduler(){
+  std::vector <std::shared_ptr <Task>> blocked;
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    stopping = true;
+    blocked = stalled;
+  }
+  for(auto& task : blocked) task->input.abandon();
+  ready.notify_all();
+  for(auto& thread : threads) thread.join();
+}
+
+std::shared_ptr <Task> Scheduler::spawn(std::shared_ptr <const doublec::CompiledProgram> program, std::ostream& out, size_t memoryLimit, TraceBuffer* trace, const doublec::Limits& limits, const std::string* input){
+  auto task = std::make_shared <Task> ();
+  task->tracker.limit = memoryLimit;
+  task->program = std::move(program);
+  auto previous = std::exchange(MemoryTracker::active(), &task->tracker);
+  task->interpreter = std::make_unique <Interpreter> ();
+  task->interpreter->setStreams(std::cin, out);
+  task->interpreter->setInput(&task->input);
+  task->interpreter->setTrace(trace);
+  task->interpreter->setLimits(limits.steps, limits.deadline());
+  task->interpreter->start(task->program->program());
+  task->interpreter->onStall([this, weak = std::weak_ptr <Task> (task)]{
+    if(auto task = weak.lock()) stall(task);
+  });
+  MemoryTracker::active() = previous;
+  if(input){
+    task->input.write(*input);
+    task->input.close();
+  }
+  task->input.onData([this, weak = std::weak_ptr <Task> (task)]{
+    if(auto task = weak.lock()) wake(task);
+  });
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    pending++;
+    queue.push_back(task);
+  }
+  ready.notify_one();
+  return task;
+}
+
+void Scheduler::wake(const std::shared_ptr <Task>& task){
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    if(task->state == Task::State::Running) task->notified = true;
+    if(task->state != Task::State::Waiting) return;
+    task->state = Task::State::Queued;
+    queue.push_back(task);
+  }
+  ready.notify_one();
+}
+
+void Scheduler::stall(const std::shared_ptr <Task>& task){
+  std::lock_guard <std::mutex> guard(lock);
+  if(stopping){
+    task->input.abandon();
+    return;
+  }
+  stalled.push_back(task);
+  if(active - stalled.size() >= workers) return;
+  // Stand-ins that retired since the last stall are joined first, so their handles do not pile up.
+  for(auto id : retired){
+    auto found = std::find_if(threads.begin(), threads.end(), [&](const std::thread& thread){ return thread.get_id() == id; });
+    found->join();
+    threads.erase(found);
+  }
+  retired.clear();
+  active++;
+  threads.emplace_back(&Scheduler::workerLoop, this);
+}
+
+void Scheduler::wait(){
+  std::unique_lock <std::mutex> guard(lock);
+  idle.wait(guard, [&]{ return pending == 0; });
+}
+
+void Scheduler::workerLoop(){
+  while(true){
+    std::shared_ptr <Task> task;
+    {
+      std::unique_lock <std::mutex> guard(lock);
+      ready.wait(guard, [&]{ return stopping || !queue.empty(); });
+      if(stopping) return;
+      task = std::move(queue.front());
+      queue.pop_front();
+      task->state = Task::State::Running;
+      task->notified = false;
+    }
+    auto previous = std::exchange(MemoryTracker::active(), &task->tracker);
+    auto state = Interpreter::RunState::Finished;
+    try{
+      state = task->interpreter->resume(slice);
+    }
+    catch(...){
+      task->result = doublec::formatError(std::current_exception(), task->message);
+    }
+    if(state == Interpreter::RunState::Finished) task->interpreter.reset();
+    MemoryTracker::active() = previous;
+    bool requeue = false;
+    bool retire = false;
+    {
+      std::lock_guard <std::mutex> guard(lock);
+      std::erase(stalled, task);
+      // A worker that stood in for a stalled one retires once enough are free again.
+      if(active - stalled.size() > workers){
+        active--;
+        retired.push_back(std::this_thread::get_id());
+        retire = true;
+      }
+      if(state == Interpreter::RunState::Finished){
+        task->state = Task::State::Done;
+        task->finished.store(true, std::memory_order_release);
+        if(--pending == 0) idle.notify_all();
+      }
+      else if(state == Interpreter::RunState::Preempted || task->notified){
+        task->state = Task::State::Queued;
+        queue.push_back(task);
+        requeue = true;
+      }
+      else task->state = Task::State::Waiting;
+    }
+    if(requeue) ready.notify_one();
+    if(retire) return;
+  }
+}
@@ -0,0 +1,111 @@
+#include "threadpool.h"
+#include <algorithm>
+
+static thread_local bool insidePool = false;
+
+ThreadPool::ThreadPool(size_t count){
+  if(count == 0) count = std::thread::hardware_concurrency();
+  if(count == 0) count = 1;
+  for(size_t i = 0; i <= count; i++) queues.push_back(std::make_unique <Queue> ());
+  for(size_t i = 0; i < count; i++) threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool(){
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for(auto& thread : threads) thread.join();
+}
+
+size_t ThreadPool::size() const{
+  return threads.size();
+}
+
+ThreadPool& ThreadPool::shared(){
+  static ThreadPool pool;
+  return pool;
+}
+
+bool ThreadPool::runOne(size_t id){
+  std::pair <size_t, size_t> range;
+  bool found = false;
+  {
+    std::lock_guard <std::mutex> guard(queues[id]->lock);
+    if(!queues[id]->ranges.empty()){
+      range = queues[id]->ranges.back();
+      queues[id]->ranges.pop_back();
+      found = true;
+    }
+  }
+  for(size_t i = 1; !found && i < queues.size(); i++){
+    auto& victim = *queues[(id + i) % queues.size()];
+    std::lock_guard <std::mutex> guard(victim.lock);
+    if(!victim.ranges.empty()){
+      range = victim.ranges.front();
+      victim.ranges.pop_front();
+      found = true;
+    }
+  }
+  if(!found) return false;
+  for(size_t i = range.first; i < range.second; i++){
+    try{
+      (*job)(i);
+    }
+    catch(...){
+      std::lock_guard <std::mutex> guard(lock);
+      if(!error) error = std::current_exception();
+    }
+  }
+  if(remaining.fetch_sub(range.second - range.first) == range.second - range.first){
+    std::lock_guard <std::mutex> guard(lock);
+    finished.notify_all();
+  }
+  return true;
+}
+
+void ThreadPool::workerLoop(size_t id){
+  insidePool = true;
+  uint64_t seen = 0;
+  while(true){
+    {
+      std::unique_lock <std::mutex> guard(lock);
+      wake.wait(guard, [&]{ return stopping || generation != seen; });
+      if(stopping) return;
+      seen = generation;
+    }
+    while(runOne(id)) {}
+  }
+}
+
+void ThreadPool::run(size_t count, const std::function <void(size_t)>& task){
+  if(count == 0) return;
+  std::unique_lock <std::mutex> running(runLock, std::try_to_lock);
+  if(insidePool || !running.owns_lock() || count == 1){
+    for(size_t i = 0; i < count; i++) task(i);
+    return;
+  }
+  size_t chunk = std::max <size_t> (1, count / (queues.size() * 4));
+  job = &task;
+  error = nullptr;
+  remaining = count;
+  size_t queue = 0;
+  for(size_t begin = 0; begin < count; begin += chunk){
+    auto& target = *queues[queue++ % queues.size()];
+    std::lock_guard <std::mutex> guard(target.lock);
+    target.ranges.emplace_back(begin, std::min(begin + chunk, count));
+  }
+  {
+    std::lock_guard <std::mutex> guard(lock);
+    generation++;
+  }
+  wake.notify_all();
+  insidePool = true;
+  while(runOne(threads.size())) {}
+  insidePool = false;
+  std::unique_lock <std::mutex> guard(lock);
+  finished.wait(guard, [&]{ return remaining.load() == 0; });
+  job = nullptr;
+  if(error) std::rethrow_exception(std::exchange(error, nullptr));
+}
@@ -0,0 +1,95 @@
+#include "trace.h"
+#include "map.h"
+#include "bigint.h"
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static constexpr char traceMagic[8] = {'D', 'C', 'T', 'R', 'A', 'C', 'E', '1'};
+
+TraceBuffer::TraceBuffer(size_t capacity){
+  capacity = std::bit_ceil(capacity < 2 ? size_t(2) : capacity);
+  records = std::make_unique <TraceRecord[]> (capacity);
+  mask = capacity - 1;
+}
+
+void TraceBuffer::record(TraceKind kind, const Location& location, const Value& value){
+  int64_t payload = 0;
+  switch(value.type){
+    case Datatype::Int:
+      if(auto big = std::get_if <Cow <BigInt>> (&value.data)) payload = (*big)->negative() ? INT64_MIN : INT64_MAX;
+      else payload = std::get <int64_t> (value.data);
+      break;
+    case Datatype::Double:
+      payload = std::bit_cast <int64_t> (std::get <double> (value.data));
+      break;
+    case Datatype::Char:
+      payload = static_cast <unsigned char> (std::get <char> (value.data));
+      break;
+    case Datatype::Bool:
+      payload = std::get <bool> (value.data);
+      break;
+    case Datatype::String:
+      payload = std::get <Cow <String>> (value.data)->size();
+      break;
+    case Datatype::Array:
+      payload = std::get <Cow <Array>> (value.data)->size();
+      break;
+    case Datatype::Map:
+      payload = std::get <Cow <Map>> (value.data)->size();
+      break;
+    default:
+      break;
+  }
+  record(kind, location, value.type, payload);
+}
+
+void TraceBuffer::dump(const std::string& path) const{
+  std::ofstream out(path, std::ios::binary);
+  if(!out.is_open()) throw std::runtime_error("Cannot open the trace file " + path);
+  uint64_t total = head.load(std::memory_order_relaxed);
+  uint64_t capacity = mask + 1;
+  uint64_t count = total < capacity ? total : capacity;
+  out.write(traceMagic, sizeof(traceMagic));
+  out.write(reinterpret_cast <const char*> (&total), sizeof(total));
+  out.write(reinterpret_cast <const char*> (&count), sizeof(count));
+  for(uint64_t i = total - count; i < total; i++){
+    out.write(reinterpret_cast <const char*> (&records[i & mask]), sizeof(TraceRecord));
+  }
+}
+
+std::vector <TraceRecord> TraceBuffer::load(const std::string& path, uint64_t& total){
+  std::ifstream in(path, std::ios::binary);
+  if(!in.is_open()) throw std::runtime_error("Cannot open the trace file " + path);
+  char magic[sizeof(traceMagic)];
+  uint64_t count = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast <char*> (&total), sizeof(total));
+  in.read(reinterpret_cast <char*> (&count), sizeof(count));
+  if(!in || std::memcmp(magic, traceMagic, sizeof(magic)) != 0) throw std::runtime_error("Not a DoubleC trace file");
+  auto header = in.tellg();
+  in.seekg(0, std::ios::end);
+  uint64_t remaining = in.tellg() - header;
+  in.seekg(header);
+  if(count > remaining / sizeof(TraceRecord)) throw std::runtime_error("The trace file is truncated");
+  std::vector <TraceRecord> result(count);
+  in.read(reinterpret_cast <char*> (result.data()), count * sizeof(TraceRecord));
+  if(!in) throw std::runtime_error("The trace file is truncated");
+  return result;
+}
+
+const char* traceKindName(uint8_t kind){
+  static constexpr std::array <const char*, static_cast <size_t> (TraceKind::amount)> names {
+    "out", "in", "define", "if", "while", "for", "iteration"
+  };
+  return kind < names.size() ? names[kind] : "?";
+}
+
+const char* datatypeName(uint8_t tag){
+  static constexpr std::array <const char*, static_cast <size_t> (Datatype::Invalid) + 1> names {
+    "int", "char", "string", "double", "bool", "array", "map", "-"
+  };
+  return tag < names.size() ? names[tag] : "?";
+}
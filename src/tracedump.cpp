@@ -0,0 +1,48 @@
+#include <iostream>
+#include <bit>
+#include "trace.h"
+
+int main(int argc, char* argv[]){
+  if(argc != 2){
+    std::cout << "Usage: DoubleCTrace <trace file>\n";
+    return -4;
+  }
+  try{
+    uint64_t total = 0;
+    auto records = TraceBuffer::load(argv[1], total);
+    std::cout << total << " steps recorded, last " << records.size() << " kept\n";
+    uint64_t step = total - records.size();
+    for(const auto& record : records){
+      std::cout << "#" << step++ << "\t" << traceKindName(record.kind) << "\tline " << record.line;
+      if(record.column != 0) std::cout << ":" << record.column;
+      std::cout << "\t" << datatypeName(record.tag);
+      switch(static_cast <Datatype> (record.tag)){
+        case Datatype::Int:
+          std::cout << " " << record.payload;
+          break;
+        case Datatype::Double:
+          std::cout << " " << std::bit_cast <double> (record.payload);
+          break;
+        case Datatype::Char:
+          std::cout << " '" << static_cast <char> (record.payload) << "'";
+          break;
+        case Datatype::Bool:
+          std::cout << (record.payload ? " true" : " false");
+          break;
+        case Datatype::String:
+        case Datatype::Array:
+        case Datatype::Map:
+          std::cout << " size " << record.payload;
+          break;
+        default:
+          break;
+      }
+      std::cout << "\n";
+    }
+  }
+  catch(const std::runtime_error& err){
+    std::cerr << "Error: " << err.what() << std::endl;
+    return -3;
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include "check.h"
+#include "cache.h"
+#include "lexer.h"
+#include "parser.h"
+
+// A cache directory of its own, removed when the test ends.
+struct CacheDirectory{
+  std::filesystem::path path = std::filesystem::temp_directory_path() / ("doublec-cache-" + std::to_string(::getpid()));
+  ProgramCache cache{path.string()};
+  ~CacheDirectory(){
+    std::filesystem::remove_all(path);
+  }
+  std::vector <std::filesystem::path> files() const{
+    std::vector <std::filesystem::path> found;
+    for(const auto& entry : std::filesystem::directory_iterator(path)) found.push_back(entry.path());
+    return found;
+  }
+};
+
+static std::unique_ptr <Program> parse(const std::string& source){
+  Lexer lexer;
+  lexer.load(source);
+  auto tokens = lexer.Tokenize();
+  auto program = std::make_unique <Program> ();
+  Parser(tokens).Parse(*program);
+  return program;
+}
+
+// Uses every node the cache stores, including empty ones: a bare return, a for without a step and an else arm.
+static const std::string everyNode =
+  "pure func twice(n){\n"
+  "  return n * 2\n"
+  "}\n"
+  "func show(v){\n"
+  "  out(v)\n"
+  "  return\n"
+  "}\n"
+  "in(a)\n"
+  "in(int(b))\n"
+  "list = [a, b, 3]\n"
+  "list[0] = \"x\"\n"
+  "m = {\"k\": 1.5, 2: 'c'}\n"
+  "if(b > 1){\n"
+  "  out(list[0])\n"
+  "}\n"
+  "else{\n"
+  "  out(m[\"k\"])\n"
+  "}\n"
+  "i = 0\n"
+  "while(i < 2){\n"
+  "  i = i + 1\n"
+  "}\n"
+  "for(j -> 3){\n"
+  "  show(twice(j))\n"
+  "}\n"
+  "for(k -> 9 (k = k + 3)){\n"
+  "  out(k)\n"
+  "}\n"
+  "out(string(i) + \" \" + a)\n";
+
+TEST(cache, FunctionsRoundTrip){
+  std::string source =
+    "pure func twice(n){\n"
+    "  return n * 2\n"
+    "}\n"
+    "func show(n){\n"
+    "  out(twice(n))\n"
+    "  return\n"
+    "}\n"
+    "show(21)\n";
+  CacheDirectory directory;
+  std::ostringstream first, second;
+  doublec::Context(std::cin, first).run(*doublec::compile(source, &directory.cache));
+  Program program;
+  CHECK(directory.cache.load(source, program));
+  doublec::Context(std::cin, second).run(*doublec::compile(source, &directory.cache));
+  CHECK_EQ(first.str(), std::string("42"));
+  CHECK_EQ(second.str(), std::string("42"));
+}
+
+TEST(cache, EveryNodeRoundTrip){
+  auto bytes = serialize(*parse(everyNode));
+  Program loaded;
+  deserialize(bytes.data(), bytes.size(), loaded);
+  CHECK(serialize(loaded) == bytes);
+  for(size_t size = 0; size < bytes.size(); size++){
+    Program truncated;
+    bool rejected = false;
+    try{
+      deserialize(bytes.data(), size, truncated);
+    }
+    catch(const std::runtime_error&){
+      rejected = true;
+    }
+    CHECK(rejected);
+  }
+  std::istringstream in("w 5");
+  std::ostringstream out;
+  doublec::Context(in, out).run(doublec::CompiledProgram(std::make_unique <Program> (std::move(loaded))));
+  CHECK_EQ(out.str(), runScript(everyNode, "w 5"));
+}
+
+TEST(cache, EditedSourceGetsNewKey){
+  CacheDirectory directory;
+  std::string source = "out(1)\n", edited = "out(2)\n";
+  CHECK(sourceHash(source) != sourceHash(edited));
+  directory.cache.store(source, *parse(source));
+  Program program;
+  CHECK(!directory.cache.load(edited, program));
+  directory.cache.store(edited, *parse(edited));
+  CHECK_EQ(directory.files().size(), size_t(2));
+  CHECK(directory.cache.load(edited, program));
+}
+
+TEST(cache, DamagedFileFallsBackToParsing){
+  CacheDirectory directory;
+  std::string source = "x = 2\nout(x * 21)\n";
+  directory.cache.store(source, *parse(source));
+  auto file = directory.files().at(0);
+  auto size = std::filesystem::file_size(file);
+  Program program;
+  std::filesystem::resize_file(file, size - 3);
+  CHECK(!directory.cache.load(source, program));
+  CHECK(program.statements.empty());
+  std::ostringstream out;
+  doublec::Context(std::cin, out).run(*doublec::compile(source, &directory.cache));
+  CHECK_EQ(out.str(), std::string("42"));
+  CHECK(directory.cache.load(source, program));
+  {
+    std::fstream stream(file, std::ios::in | std::ios::out | std::ios::binary);
+    stream.seekp(size - 2);
+    stream.put('\xff');
+  }
+  Program damaged;
+  CHECK(!directory.cache.load(source, damaged));
+  CHECK(damaged.statements.empty());
+}
+
+TEST(cache, FormatBumpInvalidates){
+  CacheDirectory directory;
+  std::string source = "out(1)\n";
+  CHECK(sourceHash(source, ProgramCache::currentFormat) != sourceHash(source, ProgramCache::currentFormat + 1));
+  directory.cache.store(source, *parse(source));
+  Program program;
+  CHECK(!ProgramCache(directory.path.string(), ProgramCache::currentFormat + 1).load(source, program));
+  CHECK(directory.cache.load(source, program));
+}
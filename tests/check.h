@@ -0,0 +1,64 @@
+#pragma once
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "doublec.h"
+
+// A minimal self-registering test runner; tests/main.cpp runs every test of the suite named on the command line.
+struct TestCase{
+  const char* suite;
+  const char* name;
+  void (*run)();
+};
+
+std::vector <TestCase>& testRegistry();
+
+struct TestRegistration{
+  TestRegistration(const char* suite, const char* name, void (*run)()){
+    testRegistry().push_back({suite, name, run});
+  }
+};
+
+#define TEST(suite, name) \
+  static void suite##_##name(); \
+  static const TestRegistration suite##_##name##_registration(#suite, #name, &suite##_##name); \
+  static void suite##_##name()
+
+#define CHECK(condition) \
+  do{ \
+    if(!(condition)) throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK(" #condition ") failed"); \
+  } while(false)
+
+#define CHECK_EQ(actual, expected) \
+  do{ \
+    auto actualValue = (actual); \
+    auto expectedValue = (expected); \
+    if(!(actualValue == expectedValue)){ \
+      std::ostringstream message; \
+      message << __FILE__ << ":" << __LINE__ << ": " #actual " is \"" << actualValue << "\", expected \"" << expectedValue << "\""; \
+      throw std::runtime_error(message.str()); \
+    } \
+  } while(false)
+
+// Compiles and runs `source` with `input` as stdin and returns what it printed.
+inline std::string runScript(const std::string& source, const std::string& input = ""){
+  std::istringstream in(input);
+  std::ostringstream out;
+  doublec::Context context(in, out);
+  context.run(*doublec::compile(source));
+  return out.str();
+}
+
+// The message the command line prints for the error `source` fails with, or "" when it runs through.
+inline std::string scriptError(const std::string& source, const std::string& input = ""){
+  try{
+    runScript(source, input);
+  }
+  catch(...){
+    std::string message;
+    doublec::formatError(std::current_exception(), message);
+    return message;
+  }
+  return "";
+}
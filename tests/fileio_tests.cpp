@@ -0,0 +1,134 @@
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include "check.h"
+#include "fileio.h"
+#include "trace.h"
+
+// A file of its own with the given contents, removed when the test ends.
+struct TemporaryFile{
+  std::string path;
+  explicit TemporaryFile(std::string_view contents, const char* name = "input"){
+    path = (std::filesystem::temp_directory_path() / ("doublec-" + std::string(name) + "-" + std::to_string(::getpid()))).string();
+    int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(file < 0 || ::write(file, contents.data(), contents.size()) != static_cast <ssize_t> (contents.size())) throw std::runtime_error("Cannot write " + path);
+    ::close(file);
+  }
+  ~TemporaryFile(){
+    std::filesystem::remove(path);
+  }
+};
+
+TEST(fileio, WordsAndLines){
+  TemporaryFile file("a b\r\nc  d\n\nlast");
+  MappedFile words(file.path);
+  for(auto expected : {"a", "b", "c", "d", "last", ""}) CHECK_EQ(words.word(), std::string_view(expected));
+  CHECK(words.atEnd());
+  MappedFile lines(file.path);
+  for(auto expected : {"a b", "c  d", "", "last"}) CHECK_EQ(lines.line(), std::string_view(expected));
+  CHECK(lines.atEnd());
+  CHECK_EQ(lines.line(), std::string_view());
+}
+
+TEST(fileio, EmptyFile){
+  TemporaryFile file("");
+  MappedFile mapped(file.path);
+  CHECK(mapped.atEnd());
+  CHECK_EQ(mapped.line(), std::string_view());
+  CHECK_EQ(mapped.word(), std::string_view());
+  CHECK_EQ(mapped.contents().size(), size_t(0));
+  CHECK_EQ(runScript("out(\"[\" + read_file(\"" + file.path + "\") + \"]\")\n"), std::string("[]"));
+}
+
+TEST(fileio, ReadlineUntilEof){
+  TemporaryFile file("a b\r\nc  d\n\nlast");
+  CHECK_EQ(runScript(
+    "open_input(\"" + file.path + "\")\n"
+    "while(eof() == false){\n"
+    "  l = readline()\n"
+    "  out(\"[\" + l + \"]\")\n"
+    "}\n"
+    "close_input()\n"), std::string("[a b][c  d][][last]"));
+}
+
+TEST(fileio, WordsFromInputFile){
+  TemporaryFile file(" 12\n\t7 x ");
+  CHECK_EQ(runScript(
+    "open_input(\"" + file.path + "\")\n"
+    "in(int(a))\n"
+    "in(int(b))\n"
+    "in(c)\n"
+    "out(a + b)\n"
+    "out(c)\n"
+    "out(eof())\n"), std::string("19x0"));
+}
+
+TEST(fileio, OutputFile){
+  TemporaryFile file("", "output");
+  CHECK_EQ(runScript(
+    "out(1)\n"
+    "open_output(\"" + file.path + "\")\n"
+    "out(\"to file\")\n"
+    "close_output()\n"
+    "out(2)\n"
+    "out(read_file(\"" + file.path + "\"))\n"), std::string("12to file"));
+}
+
+TEST(fileio, CloseOutputFailure){
+  CHECK_EQ(scriptError(
+    "open_output(\"/dev/full\")\n"
+    "out(\"x\")\n"
+    "close_output()\n"), std::string("Runtime error: Cannot write the file /dev/full at line: 3; column: 1"));
+}
+
+// A sparse file past 4 GiB costs no disk space; only the pages actually read are touched.
+TEST(fileio, OffsetsPastFourGiB){
+  TemporaryFile file("first line\n", "large");
+  const off_t size = (off_t(4) << 30) + 4096;
+  int handle = ::open(file.path.c_str(), O_WRONLY);
+  CHECK(handle >= 0);
+  CHECK(::ftruncate(handle, size) == 0);
+  CHECK(::pwrite(handle, "tail", 4, size - 4) == 4);
+  ::close(handle);
+  MappedFile mapped(file.path);
+  CHECK_EQ(mapped.contents().size(), size_t(size));
+  CHECK_EQ(mapped.line(), std::string_view("first line"));
+  CHECK_EQ(mapped.contents().substr(size - 4), std::string_view("tail"));
+  CHECK(!mapped.atEnd());
+}
+
+// The error TraceBuffer::load fails with on `path`, or "" when it loads.
+static std::string traceError(const std::string& path){
+  try{
+    uint64_t total = 0;
+    TraceBuffer::load(path, total);
+  }
+  catch(const std::runtime_error& err){
+    return err.what();
+  }
+  return "";
+}
+
+TEST(fileio, TraceRoundTrip){
+  TemporaryFile file("", "trace");
+  TraceBuffer buffer(4);
+  for(size_t line = 1; line <= 6; line++) buffer.record(TraceKind::Output, Location{0, line}, Datatype::Int, line * 10);
+  buffer.dump(file.path);
+  uint64_t total = 0;
+  auto records = TraceBuffer::load(file.path, total);
+  CHECK_EQ(total, uint64_t(6));
+  CHECK_EQ(records.size(), size_t(4));
+  CHECK_EQ(records.front().line, uint32_t(3));
+  CHECK_EQ(records.back().payload, int64_t(60));
+}
+
+TEST(fileio, TraceCountPastFileSize){
+  std::string header("DCTRACE1", 8);
+  for(uint64_t field : {uint64_t(1), UINT64_MAX / 2}) header.append(reinterpret_cast <const char*> (&field), sizeof(field));
+  TemporaryFile huge(header + std::string(sizeof(TraceRecord), '\0'), "trace");
+  CHECK_EQ(traceError(huge.path), std::string("The trace file is truncated"));
+  header.replace(16, 8, std::string("\2\0\0\0\0\0\0\0", 8));
+  TemporaryFile truncated(header + std::string(sizeof(TraceRecord), '\0'), "trace-short");
+  CHECK_EQ(traceError(truncated.path), std::string("The trace file is truncated"));
+  CHECK_EQ(traceError(huge.path + ".missing"), "Cannot open the trace file " + huge.path + ".missing");
+}
@@ -0,0 +1,664 @@
+#include <chrono>
+#include <thread>
+#include "check.h"
+#include "interpreter.h"
+
+TEST(interpreter, CallInWhileCondition){
+  CHECK_EQ(runScript(
+    "func g(n){\n"
+    "  return n\n"
+    "}\n"
+    "i = 0\n"
+    "while(g(i) < 5){\n"
+    "  out(i)\n"
+    "  i = i + 1\n"
+    "}\n"), std::string("01234"));
+}
+
+TEST(interpreter, CallInForStep){
+  CHECK_EQ(runScript(
+    "func g(n){\n"
+    "  return n\n"
+    "}\n"
+    "for(j -> 10 (j = g(j) + 2)){\n"
+    "  out(j)\n"
+    "}\n"), std::string("02468"));
+}
+
+TEST(interpreter, PureRejectsImpureCalls){
+  CHECK_EQ(scriptError(
+    "func say(n){\n"
+    "  out(\"called\")\n"
+    "  return n\n"
+    "}\n"
+    "pure func p(n){\n"
+    "  return say(n) + 1\n"
+    "}\n"), std::string("Syntax error: Impure function \"say\" is not permitted inside a pure function at line: 6"));
+  CHECK_EQ(scriptError(
+    "pure func p(n){\n"
+    "  return later(n) + 1\n"
+    "}\n"
+    "func later(n){\n"
+    "  return n\n"
+    "}\n"), std::string("Syntax error: Impure function \"later\" is not permitted inside a pure function at line: 2"));
+  CHECK_EQ(scriptError(
+    "pure func r(n){\n"
+    "  return readline()\n"
+    "}\n"), std::string("Syntax error: Function \"readline\" is not permitted inside a pure function at line: 2"));
+}
+
+TEST(interpreter, PureCallsPure){
+  CHECK_EQ(runScript(
+    "pure func fib(n){\n"
+    "  if(n < 2){\n"
+    "    return n\n"
+    "  }\n"
+    "  return fib(n - 1) + fib(n - 2) + zero(n)\n"
+    "}\n"
+    "pure func zero(n){\n"
+    "  return n - n\n"
+    "}\n"
+    "out(fib(20))\n"), std::string("6765"));
+}
+
+TEST(interpreter, ReleaseKeepsBoundNames){
+  auto first = doublec::compile("n = len(line)\nout(n)\nout(\"|\")\n");
+  auto second = doublec::compile("out(line)\n");
+  std::istringstream in;
+  std::ostringstream out;
+  Interpreter interpreter;
+  interpreter.setStreams(in, out);
+  interpreter.bind("line", std::string_view("abc"));
+  interpreter.execute(first->program());
+  interpreter.execute(second->program());
+  CHECK_EQ(out.str(), std::string("3|abc"));
+}
+
+TEST(interpreter, EachLineWithEarlyLastUse){
+  std::istringstream in("ab\ncde\n");
+  std::ostringstream out;
+  doublec::Context context(in, out);
+  context.runEachLine(*doublec::compile("n = len(line)\nout(nr)\nout(\":\")\nout(n)\nout(\" \")\n"));
+  CHECK_EQ(out.str(), std::string("1:2 2:3 "));
+}
+
+TEST(interpreter, TruncatedCall){
+  CHECK_EQ(scriptError("x = f("), std::string("Syntax error: Invalid component of the expression at line: 1; column: 7"));
+  CHECK_EQ(scriptError("f(x"), std::string("Syntax error: Expected \")\" at line: 1; column: 4"));
+  CHECK_EQ(scriptError("f("), std::string("Syntax error: Invalid component of the expression at line: 1; column: 3"));
+}
+
+TEST(interpreter, CallWithoutSlotsKeepsCallerScopes){
+  CHECK_EQ(scriptError(
+    "func g(){\n"
+    "  if(true){\n"
+    "    return 1\n"
+    "  }\n"
+    "}\n"
+    "i = 0\n"
+    "while(i < 2){\n"
+    "  if(i == 1){\n"
+    "    out(y)\n"
+    "  }\n"
+    "  y = 777\n"
+    "  g()\n"
+    "  i = i + 1\n"
+    "  out(y)\n"
+    "}\n"), std::string("Runtime error: No such variable seems to be defined at line: 9; column: 9"));
+}
+
+TEST(interpreter, FailedCallRestoresState){
+  auto failing = doublec::compile(
+    "func f(n){\n"
+    "  return n / 0\n"
+    "}\n"
+    "func g(n){\n"
+    "  return n\n"
+    "}\n"
+    "out(g(f(1)))\n");
+  auto scoped = doublec::compile(
+    "if(true){\n"
+    "  y = 2\n"
+    "}\n"
+    "out(y)\n");
+  std::istringstream in;
+  std::ostringstream out;
+  Interpreter interpreter;
+  interpreter.setStreams(in, out);
+  for(int attempt = 0; attempt < 2; attempt++){
+    bool failed = false;
+    try{
+      interpreter.execute(failing->program());
+    }
+    catch(const std::exception&){
+      failed = true;
+    }
+    CHECK(failed);
+  }
+  bool unknown = false;
+  try{
+    interpreter.execute(scoped->program());
+  }
+  catch(const std::exception& err){
+    unknown = std::string(err.what()).find("No such variable") != std::string::npos;
+  }
+  CHECK(unknown);
+}
+
+TEST(interpreter, PipelinedRunsStatementsBeforeSyntaxError){
+  std::istringstream in;
+  std::ostringstream out;
+  doublec::Context context(in, out);
+  std::string message;
+  try{
+    context.runPipelined("out(1)\nout(2)\nout(3)\nx = 4\nout(x)\nout(6)\ny = = 1\n");
+  }
+  catch(...){
+    doublec::formatError(std::current_exception(), message);
+  }
+  CHECK_EQ(out.str(), std::string("12346"));
+  CHECK(message.rfind("Syntax error:", 0) == 0);
+}
+
+// The message a run with `limits` fails with, and how long it took to fail.
+static std::string limitError(const std::string& source, const doublec::Limits& limits, double& seconds){
+  std::istringstream in;
+  std::ostringstream out;
+  doublec::Context context(in, out);
+  context.setLimits(limits);
+  auto program = doublec::compile(source);
+  std::string message;
+  auto start = std::chrono::steady_clock::now();
+  try{
+    context.run(*program);
+  }
+  catch(...){
+    doublec::formatError(std::current_exception(), message);
+  }
+  seconds = std::chrono::duration <double> (std::chrono::steady_clock::now() - start).count();
+  return message;
+}
+
+static const char* endlessLoop =
+  "x = 0\n"
+  "while(true){\n"
+  "  x = x + 1\n"
+  "}\n";
+
+// Never deeper than 40 calls, but 2^40 of them.
+static const char* endlessRecursion =
+  "func f(n){\n"
+  "  if(n == 0){\n"
+  "    return 0\n"
+  "  }\n"
+  "  return f(n - 1) + f(n - 1)\n"
+  "}\n"
+  "out(f(40))\n";
+
+TEST(interpreter, StepLimitStopsEndlessLoop){
+  doublec::Limits limits;
+  limits.steps = 100000;
+  double seconds;
+  CHECK(limitError(endlessLoop, limits, seconds).find("Runtime error: The step limit is exceeded at line:") == 0);
+}
+
+TEST(interpreter, StepLimitStopsRecursion){
+  doublec::Limits limits;
+  limits.steps = 100000;
+  double seconds;
+  CHECK(limitError(endlessRecursion, limits, seconds).find("Runtime error: The step limit is exceeded at line:") == 0);
+  CHECK(limitError("func f(n){\n  return f(n + 1)\n}\nout(f(0))\n", {500}, seconds).find("Runtime error: The step limit is exceeded at line:") == 0);
+}
+
+TEST(interpreter, TimeLimitStopsEndlessLoop){
+  doublec::Limits limits;
+  limits.timeout = std::chrono::duration <double> (0.2);
+  double seconds;
+  CHECK(limitError(endlessLoop, limits, seconds).find("Runtime error: The time limit is exceeded at line:") == 0);
+  CHECK(seconds < 5);
+}
+
+TEST(interpreter, TimeLimitStopsRecursion){
+  doublec::Limits limits;
+  limits.timeout = std::chrono::duration <double> (0.2);
+  double seconds;
+  CHECK(limitError(endlessRecursion, limits, seconds).find("Runtime error: The time limit is exceeded at line:") == 0);
+  CHECK(seconds < 5);
+}
+
+TEST(interpreter, ArrayIndexingAndAssignment){
+  CHECK_EQ(runScript(
+    "a = [1, 2, 3]\n"
+    "a[1] = 20\n"
+    "out(a)\n"
+    "out(len(a))\n"
+    "out(a[1] + a[2])\n"
+    "b = array(3, 0.5)\n"
+    "for(i -> 3){\n"
+    "  b[i] = b[i] * i\n"
+    "}\n"
+    "out(b)\n"
+    "m = [[1, 2], [3, 4]]\n"
+    "m[1][0] = 'x'\n"
+    "out(m)\n"
+    "out(len([]))\n"), std::string("[1, 20, 3]323[0, 0.5, 1][[1, 2], [x, 4]]0"));
+}
+
+TEST(interpreter, ArrayBoxesOnMixedElement){
+  CHECK_EQ(runScript(
+    "a = [1, 2, 3]\n"
+    "a[0] = 1.5\n"
+    "out(a)\n"
+    "a[2] = \"three\"\n"
+    "out(a)\n"
+    "mixed = [1, \"two\", 3.0]\n"
+    "out(mixed[1])\n"), std::string("[1.5, 2, 3][1.5, 2, three]two"));
+}
+
+TEST(interpreter, ArrayCopiesAreIndependent){
+  CHECK_EQ(runScript(
+    "a = [1, 2]\n"
+    "c = a\n"
+    "c[0] = 7\n"
+    "out(a[0])\n"
+    "out(c[0])\n"), std::string("17"));
+}
+
+TEST(interpreter, ArrayIndexOutOfRange){
+  CHECK_EQ(scriptError(
+    "a = [1, 2]\n"
+    "out(a[2])\n"), std::string("Runtime error: The array index is out of range at line: 2; column: 6"));
+  CHECK_EQ(scriptError(
+    "a = [[1], [2]]\n"
+    "out(a[1][3])\n"), std::string("Runtime error: The array index is out of range at line: 2; column: 9"));
+}
+
+TEST(interpreter, StringConcatenation){
+  CHECK_EQ(runScript(
+    "s = \"ab\"\n"
+    "s = s + s\n"
+    "out(s)\n"
+    "s = s + 'c' + 1 + s\n"
+    "out(s)\n"
+    "out(5 + \"y\")\n"
+    "out(\"arr\" + [1, 2])\n"
+    "out(string(\"q\") + int(\"12\"))\n"), std::string("ababababc1abab5yarr[1, 2]q12"));
+}
+
+TEST(interpreter, StringAppendInLoop){
+  CHECK_EQ(runScript(
+    "i = 0\n"
+    "r = \"\"\n"
+    "while(i < 5){\n"
+    "  r = r + i + \",\"\n"
+    "  i = i + 1\n"
+    "}\n"
+    "out(r)\n"
+    "out(len(r))\n"), std::string("0,1,2,3,4,10"));
+}
+
+TEST(interpreter, StringComparison){
+  CHECK_EQ(runScript(
+    "out(\"abc\" < \"abd\")\n"
+    "out(\"abc\" == \"abc\")\n"
+    "out(\"a\" != \"a\")\n"
+    "out(\"b\" >= \"abc\")\n"), std::string("1101"));
+}
+
+// An else-if chain over `keys` that prints the index of the matching arm, or "-" in the final else.
+// Nested puts each arm in the else block of the previous one, which the optimizer leaves as plain ifs.
+static std::string equalityChain(const std::vector <std::string>& keys, bool nested, bool otherwise = true){
+  std::string source, closing;
+  for(size_t i = 0; i < keys.size(); i++){
+    if(i > 0) source += nested ? "else{\n" : "else ";
+    if(i > 0 && nested) closing += "}\n";
+    source += "if(x == " + keys[i] + "){\n  out(\"" + std::to_string(i) + " \")\n}\n";
+  }
+  if(otherwise) source += "else{\n  out(\"- \")\n}\n";
+  return source + closing;
+}
+
+static std::string overValues(const std::string& values, const std::string& body){
+  return "v = [" + values + "]\nfor(i -> len(v)){\n  x = v[i]\n" + body + "}\n";
+}
+
+TEST(interpreter, JumpTableMatchesElseIfChain){
+  const std::vector <std::pair <std::string, std::vector <std::string>>> cases{
+    {"0 - 1, 0, 1, 2, 3, 4, 5, 2.0, true, false", {"0", "1", "2", "3", "1"}},
+    {"0, 1000003, 2000006, 3000009, 5000015, 7, 0 - 7", {"0", "1000003", "3000009", "5000015", "7"}},
+    {"0 - 9223372036854775807, 9223372036854775807, 9223372036854775807 + 1, 4611686018427387904, 0, 3",
+      {"9223372036854775807", "0", "4611686018427387904", "1", "2"}},
+    {"'a', 'b', 'c', 'z', 98, 99", {"'a'", "'b'", "'c'", "98", "'z'"}}
+  };
+  for(const auto& [values, keys] : cases){
+    for(bool otherwise : {true, false}){
+      auto expected = runScript(overValues(values, equalityChain(keys, true, otherwise)));
+      CHECK(!expected.empty());
+      CHECK_EQ(runScript(overValues(values, equalityChain(keys, false, otherwise))), expected);
+    }
+  }
+}
+
+TEST(interpreter, MapLookupAndAssignment){
+  CHECK_EQ(runScript(
+    "m = {\"apple\": 1, \"pear\": 2, 'c': 3, 7: \"seven\"}\n"
+    "out(m[\"apple\"])\n"
+    "out(m[99 - 92])\n"
+    "m[\"kiwi\"] = 5\n"
+    "m[\"apple\"] = m[\"apple\"] + 10\n"
+    "out(len(m))\n"
+    "out(m[\"apple\"])\n"
+    "out(contains(m, \"kiwi\"))\n"
+    "out(contains(m, \"plum\"))\n"
+    "erase(m, \"kiwi\")\n"
+    "out(contains(m, \"kiwi\"))\n"
+    "out(len(m))\n"
+    "n = {\"a\": [1, 2, 3]}\n"
+    "n[\"a\"][1] = 20\n"
+    "out(n[\"a\"])\n"
+    "out({1: 'x'})\n"), std::string("1seven5111004[1, 20, 3]{1: x}"));
+}
+
+TEST(interpreter, MapCopiesAreIndependent){
+  CHECK_EQ(runScript(
+    "m = {\"pear\": 2}\n"
+    "copy = m\n"
+    "copy[\"pear\"] = 100\n"
+    "out(m[\"pear\"])\n"
+    "out(copy[\"pear\"])\n"), std::string("2100"));
+}
+
+TEST(interpreter, MapGrowsAndShrinks){
+  CHECK_EQ(runScript(
+    "e = {}\n"
+    "for(i = 0 -> 1000){\n"
+    "  e[i] = i * i\n"
+    "}\n"
+    "out(len(e))\n"
+    "out(e[999])\n"
+    "for(i = 0 -> 1000 (i = i + 2)){\n"
+    "  erase(e, i)\n"
+    "}\n"
+    "out(len(e))\n"
+    "out(contains(e, 998))\n"
+    "out(contains(e, 997))\n"
+    "w = \"k\"\n"
+    "for(i = 0 -> 200){\n"
+    "  w = w + \"x\"\n"
+    "  e[w] = i\n"
+    "}\n"
+    "out(len(e))\n"
+    "out(e[\"kxxx\"])\n"), std::string("1000998001500017002"));
+}
+
+TEST(interpreter, MapMissingKey){
+  CHECK_EQ(scriptError(
+    "m = {\"a\": 1}\n"
+    "out(m[\"b\"])\n"), std::string("Runtime error: The key is not in the map at line: 2; column: 6"));
+}
+
+TEST(interpreter, SortSearchAndReverse){
+  CHECK_EQ(runScript(
+    "a = [5, 3, 9, 1, 3]\n"
+    "out(sort(a))\n"
+    "out(a)\n"
+    "out(sort(\"dcba\"))\n"
+    "out(sort([2.5, 1, 0.5]))\n"
+    "out(sort([\"pear\", \"apple\", \"fig\"]))\n"
+    "out(binary_search(sort(a), 5))\n"
+    "out(binary_search(sort(a), 4))\n"
+    "out(reverse(a))\n"
+    "out(reverse(\"abc\"))\n"),
+    std::string("[1, 3, 3, 5, 9][5, 3, 9, 1, 3]abcd[0.5, 1, 2.5][apple, fig, pear]3-1[3, 1, 9, 3, 5]cba"));
+}
+
+TEST(interpreter, SortLargeArray){
+  CHECK_EQ(runScript(
+    "n = 100000\n"
+    "a = array(n, 0)\n"
+    "x = 12345\n"
+    "for(i -> n){\n"
+    "  x = (x * 1103515245 + 12345) % 2147483648\n"
+    "  a[i] = x % 1000\n"
+    "}\n"
+    "s = sort(a)\n"
+    "ordered = true\n"
+    "for(i = 1 -> n){\n"
+    "  if(s[i - 1] > s[i]){\n"
+    "    ordered = false\n"
+    "  }\n"
+    "}\n"
+    "out(ordered)\n"
+    "out(sum(s) == sum(a))\n"
+    "out(len(s))\n"), std::string("11100000"));
+}
+
+TEST(interpreter, ReductionsAndStringHelpers){
+  CHECK_EQ(runScript(
+    "a = [5, 3, 9, 1, 3]\n"
+    "out(min(a))\n"
+    "out(max(4, 8, 2))\n"
+    "out(max([\"b\", \"c\", \"a\"]))\n"
+    "out(min(\"hello\"))\n"
+    "out(sum(a))\n"
+    "out(count(a))\n"
+    "out(split(\"a,b,,c\", \",\"))\n"
+    "out(len(split(\"x y  z\")))\n"
+    "out(join([\"a\", \"b\", \"c\"], \"-\"))\n"
+    "out(join([1, 2]))\n"), std::string("18ce215[a, b, , c]3a-b-c12"));
+}
+
+TEST(interpreter, BuiltinErrors){
+  CHECK_EQ(scriptError("out(len(1, 2))\n"), std::string("Runtime error: Function \"len\" expects 1 argument(s) at line: 1; column: 5"));
+  CHECK_EQ(scriptError("x = sort()\n"), std::string("Runtime error: Function \"sort\" expects 1 argument(s) at line: 1; column: 5"));
+  CHECK_EQ(scriptError("out(sort([1, \"a\"]))\n"), std::string("Runtime error: Function \"sort\" expects an array of numbers or of strings at line: 1; column: 5"));
+  CHECK_EQ(scriptError("out(nosuch(1))\n"), std::string("Runtime error: No such function seems to be defined at line: 1; column: 5"));
+}
+
+TEST(interpreter, IntPromotesAtInt64Boundaries){
+  CHECK_EQ(runScript(
+    "max = 9223372036854775807\n"
+    "min = 0 - max - 1\n"
+    "out(max + 1)\n"
+    "out(\" \")\n"
+    "out(min)\n"
+    "out(\" \")\n"
+    "out(min - 1)\n"
+    "out(\" \")\n"
+    "out(min * (0 - 1))\n"
+    "out(\" \")\n"
+    "out(min % (0 - 1))\n"
+    "out(\" \")\n"
+    "out(min / (0 - 1) > 0)\n"
+    "out(max + 1 - 1 == max)\n"
+    "out(max + 1 > max)\n"), std::string("9223372036854775808 -9223372036854775808 -9223372036854775809 9223372036854775808 0 111"));
+}
+
+TEST(interpreter, BigIntArithmetic){
+  CHECK_EQ(runScript(
+    "max = 9223372036854775807\n"
+    "out(max * max)\n"
+    "out(\" \")\n"
+    "out((max * max) % 1000000007)\n"
+    "out(\" \")\n"
+    "out(string(max + 1) + \"!\")\n"
+    "out(\" \")\n"
+    "out(int(\"-9223372036854775809\"))\n"
+    "out(\" \")\n"
+    "a = [1, 2]\n"
+    "a[0] = 18446744073709551616\n"
+    "out(a)\n"), std::string("85070591730234615847396907784232501249 737564071 9223372036854775808! -9223372036854775809 [18446744073709551616, 2]"));
+}
+
+TEST(interpreter, BigIntWhereMachineIntIsRequired){
+  CHECK_EQ(scriptError(
+    "a = [1]\n"
+    "out(a[9223372036854775807 + 1])\n"), std::string("Runtime error: The integer is too big at line: 2; column: 6"));
+}
+
+// What a run of `source` parsed with `parsing` prints, followed by the message of the error it stops with.
+static std::string runParsed(const std::string& source, doublec::Parsing parsing){
+  std::istringstream in;
+  std::ostringstream out;
+  std::string message;
+  try{
+    auto program = doublec::compile(source, nullptr, parsing);
+    doublec::Context context(in, out);
+    context.run(*program);
+  }
+  catch(...){
+    doublec::formatError(std::current_exception(), message);
+  }
+  return out.str() + message;
+}
+
+static const char* nestedBodies =
+  "func twice(n){\n"
+  "  if(n > 2){\n"
+  "    return n * 2\n"
+  "  }\n"
+  "  return n\n"
+  "}\n"
+  "for(i -> 6){\n"
+  "  if(i == 0){\n"
+  "    out(\"a\")\n"
+  "  }\n"
+  "  else if(i == 1){\n"
+  "    out(\"b\")\n"
+  "  }\n"
+  "  else if(i == 2){\n"
+  "    out(\"c\")\n"
+  "  }\n"
+  "  else if(i == 3){\n"
+  "    out(\"d\")\n"
+  "  }\n"
+  "  else{\n"
+  "    j = 0\n"
+  "    while(j < i){\n"
+  "      j = j + 1\n"
+  "    }\n"
+  "    out(twice(j))\n"
+  "  }\n"
+  "}\n";
+
+TEST(interpreter, LazyParsingMatchesEager){
+  auto expected = runParsed(nestedBodies, doublec::Parsing::Eager);
+  CHECK_EQ(expected, std::string("abcd810"));
+  CHECK_EQ(runParsed(nestedBodies, doublec::Parsing::Lazy), expected);
+  CHECK_EQ(runParsed(nestedBodies, doublec::Parsing::LazyUnchecked), expected);
+}
+
+static const char* errorInBody =
+  "out(1)\n"
+  "if(x == 1){\n"
+  "  y = = 2\n"
+  "}\n"
+  "out(2)\n";
+
+TEST(interpreter, LazyReportsErrorsBeforeRunning){
+  auto expected = runParsed(errorInBody, doublec::Parsing::Eager);
+  CHECK(expected.rfind("Syntax error:", 0) == 0);
+  CHECK_EQ(runParsed(errorInBody, doublec::Parsing::Lazy), expected);
+}
+
+TEST(interpreter, LazyUncheckedReportsErrorsWhenBodyRuns){
+  CHECK_EQ(runParsed("x = 0\n" + std::string(errorInBody), doublec::Parsing::LazyUnchecked), std::string("12"));
+  auto taken = "x = 1\n" + std::string(errorInBody);
+  auto message = runParsed(taken, doublec::Parsing::Eager);
+  CHECK(message.rfind("Syntax error:", 0) == 0);
+  CHECK_EQ(runParsed(taken, doublec::Parsing::LazyUnchecked), "1" + message);
+}
+
+TEST(interpreter, LazyBodiesLoadOnceAcrossThreads){
+  auto program = doublec::compile(nestedBodies, nullptr, doublec::Parsing::LazyUnchecked);
+  std::vector <std::string> outputs(8);
+  std::vector <std::thread> threads;
+  for(auto& output : outputs){
+    threads.emplace_back([&program, &output](){
+      std::istringstream in;
+      std::ostringstream out;
+      doublec::Context context(in, out);
+      context.run(*program);
+      output = out.str();
+    });
+  }
+  for(auto& thread : threads) thread.join();
+  for(const auto& output : outputs) CHECK_EQ(output, std::string("abcd810"));
+}
+
+// `[x][0]` is never a literal or a variable, so the optimizer leaves the expression around it unfused.
+static std::string unfused(const std::string& literal){
+  return "[" + literal + "][0]";
+}
+
+TEST(interpreter, FusedUpdateMatchesUnfused){
+  const char* starts[] = {"7", "0", "9223372036854775807", "0 - 9223372036854775807 - 1", "9223372036854775808",
+    "2.5", "\"s\"", "'a'", "true", "[1, 2]"};
+  const char* operators[] = {"+", "-", "*", "/", "%"};
+  const char* operands[] = {"3", "1", "0", "2.5"};
+  for(auto start : starts){
+    for(auto op : operators){
+      for(auto operand : operands){
+        auto prefix = "x = " + std::string(start) + "\nx = x " + op + " ";
+        auto fused = runParsed(prefix + operand + "\nout(x)\n", doublec::Parsing::Eager);
+        CHECK_EQ(runParsed(prefix + unfused(operand) + "\nout(x)\n", doublec::Parsing::Eager), fused);
+      }
+    }
+  }
+}
+
+TEST(interpreter, FusedUpdatePromotesAndDemotes){
+  auto source = [](const std::string& one){
+    return
+      "x = 9223372036854775805\n"
+      "for(i -> 4){\n"
+      "  x = x + " + one + "\n"
+      "  out(x)\n"
+      "  out(\" \")\n"
+      "}\n"
+      "for(i -> 4){\n"
+      "  x = x - " + one + "\n"
+      "  out(x)\n"
+      "  out(\" \")\n"
+      "}\n";
+  };
+  auto expected = runParsed(source(unfused("1")), doublec::Parsing::Eager);
+  CHECK_EQ(expected, std::string("9223372036854775806 9223372036854775807 9223372036854775808 9223372036854775809 "
+    "9223372036854775808 9223372036854775807 9223372036854775806 9223372036854775805 "));
+  CHECK_EQ(runParsed(source("1"), doublec::Parsing::Eager), expected);
+}
+
+TEST(interpreter, FusedComparisonMatchesUnfused){
+  struct Loop{
+    const char* start;
+    const char* condition;
+    const char* bound;
+    const char* step;
+  };
+  const Loop loops[] = {
+    {"0", "<", "5", "x = x + 1"},
+    {"0.5", "<=", "2.5", "x = x + 0.5"},
+    {"10", ">", "7.5", "x = x - 1"},
+    {"9223372036854775806", "!=", "9223372036854775809", "x = x + 1"},
+    {"9223372036854775809", ">=", "9223372036854775807", "x = x - 1"},
+    {"true", "==", "1", "x = false"},
+    {"'a'", "<", "100", "x = char(int(x) + 1)"},
+    {"\"s\"", "<", "5", "x = 5"}
+  };
+  for(const auto& loop : loops){
+    auto source = [&loop](const std::string& bound){
+      return "y = " + std::string(loop.bound) + "\nx = " + std::string(loop.start) + "\nwhile(x " + loop.condition + " " + bound + "){\n  out(x)\n  " + loop.step + "\n}\n";
+    };
+    auto expected = runParsed(source(unfused(loop.bound)), doublec::Parsing::Eager);
+    CHECK(!expected.empty());
+    CHECK_EQ(runParsed(source(loop.bound), doublec::Parsing::Eager), expected);
+    CHECK_EQ(runParsed(source("y"), doublec::Parsing::Eager), expected);
+  }
+}
+
+TEST(interpreter, RenderedOutputMatchesUnfused){
+  for(auto literal : {"7", "9223372036854775808", "2.5", "0.1", "123456789.25", "\"text\"", "'c'", "true", "false"}){
+    CHECK_EQ(runParsed("out(" + std::string(literal) + ")\n", doublec::Parsing::Eager),
+      runParsed("out(" + unfused(literal) + ")\n", doublec::Parsing::Eager));
+  }
+}
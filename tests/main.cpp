@@ -0,0 +1,27 @@
+#include <iostream>
+#include <string>
+#include "check.h"
+
+std::vector <TestCase>& testRegistry(){
+  static std::vector <TestCase> tests;
+  return tests;
+}
+
+// Usage: DoubleCTests [suite]; with no suite every test runs.
+int main(int argc, char* argv[]){
+  std::string suite = argc > 1 ? argv[1] : "";
+  size_t ran = 0, failed = 0;
+  for(const auto& test : testRegistry()){
+    if(!suite.empty() && suite != test.suite) continue;
+    ran++;
+    try{
+      test.run();
+    }
+    catch(const std::exception& err){
+      failed++;
+      std::cout << "FAIL " << test.suite << "." << test.name << ": " << err.what() << "\n";
+    }
+  }
+  std::cout << ran - failed << "/" << ran << " tests passed\n";
+  return failed == 0 && ran != 0 ? 0 : 1;
+}
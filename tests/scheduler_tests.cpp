@@ -0,0 +1,73 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+#include "check.h"
+#include "batch.h"
+#include "scheduler.h"
+
+static const char* readInCall =
+  "func get(){\n"
+  "  in(w)\n"
+  "  return \"[\" + w + \"]\"\n"
+  "}\n"
+  "out(get())\n";
+
+TEST(scheduler, CallWaitsForInput){
+  std::ostringstream out;
+  Scheduler scheduler(1, 100);
+  auto task = scheduler.spawn(doublec::compile(readInCall), out);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  task->input.write("hello");
+  task->input.close();
+  scheduler.wait();
+  CHECK_EQ(task->code(), 0);
+  CHECK_EQ(out.str(), std::string("[hello]"));
+}
+
+TEST(scheduler, LongCallDoesNotHoldWorker){
+  std::ostringstream slowOut, quickOut;
+  Scheduler scheduler(1, 100);
+  auto slow = scheduler.spawn(doublec::compile(
+    "func spin(n){\n"
+    "  i = 0\n"
+    "  while(i < n){\n"
+    "    i = i + 1\n"
+    "  }\n"
+    "  return i\n"
+    "}\n"
+    "out(spin(2000000))\n"), slowOut);
+  auto quick = scheduler.spawn(doublec::compile("out(1)\n"), quickOut);
+  while(!quick->done()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  CHECK(!slow->done());
+  scheduler.wait();
+  CHECK_EQ(slowOut.str(), std::string("2000000"));
+  CHECK_EQ(quickOut.str(), std::string("1"));
+}
+
+TEST(scheduler, StopsWhileCallWaits){
+  std::ostringstream out;
+  std::shared_ptr <Task> task;
+  {
+    Scheduler scheduler(1, 100);
+    task = scheduler.spawn(doublec::compile(readInCall), out);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  CHECK(task->done());
+  CHECK(task->code() != 0);
+}
+
+TEST(scheduler, BatchInputReachesCalls){
+  auto dir = std::filesystem::temp_directory_path() / ("doublec-batch-" + std::to_string(::getpid()));
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir / "get.dc") << readInCall;
+  std::ofstream(dir / "input.txt") << "hello";
+  std::vector <doublec::BatchJob> jobs(300, {(dir / "get.dc").string(), (dir / "input.txt").string(), "-"});
+  auto results = doublec::runBatch(jobs, nullptr, 0, nullptr);
+  std::filesystem::remove_all(dir);
+  for(const auto& result : results){
+    CHECK_EQ(result.code, 0);
+    CHECK_EQ(result.output, std::string("[hello]"));
+  }
+}